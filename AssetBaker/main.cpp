@@ -0,0 +1,107 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+#include "BakedTexture.h"
+#include "MipChain.h"
+
+// Transcodes the images of the texture folder to baked textures next to them (image name + ".baked"): full mip
+// chain, BC1 for opaque images and BC3 for those with transparency. Images older than their baked texture are
+// skipped. Run from the VulkanCourseApp folder, or give the texture folder as argument.
+
+static bool isImageFile(const std::filesystem::path& path)
+{
+  std::string extension = path.extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" ||
+         extension == ".bmp";
+}
+
+static bool isUpToDate(const std::filesystem::path& image, const std::filesystem::path& baked)
+{
+  std::error_code error;
+  auto bakedTime = std::filesystem::last_write_time(baked, error);
+  if (error)
+  {
+    return false;
+  }
+  return bakedTime >= std::filesystem::last_write_time(image, error) && !error;
+}
+
+int main(int argc, char** argv)
+{
+  const std::filesystem::path textureFolder = argc > 1 ? argv[1] : "Textures";
+
+  std::error_code error;
+  std::filesystem::directory_iterator folder(textureFolder, error);
+  if (error)
+  {
+    printf("Unable to open texture folder %s\n", textureFolder.string().c_str());
+    return EXIT_FAILURE;
+  }
+
+  int failedCount = 0;
+  uint64_t totalImageSize = 0;
+  uint64_t totalBakedSize = 0;
+  for (const auto& entry : folder)
+  {
+    const std::filesystem::path& image = entry.path();
+    if (!entry.is_regular_file() || !isImageFile(image))
+    {
+      continue;
+    }
+
+    std::filesystem::path baked = image;
+    baked += ".baked";
+    if (isUpToDate(image, baked))
+    {
+      printf("%s: up to date\n", image.filename().string().c_str());
+      continue;
+    }
+
+    int width = 0, height = 0, channels = 0;
+    stbi_uc* pixels = stbi_load(image.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    if (!pixels)
+    {
+      printf("%s: failed to load\n", image.filename().string().c_str());
+      ++failedCount;
+      continue;
+    }
+
+    // BC1 keeps no alpha, only images with transparent texels need BC3
+    bool withAlpha = false;
+    for (size_t i = 0; i < static_cast<size_t>(width) * height && !withAlpha; ++i)
+    {
+      withAlpha = pixels[i * 4 + 3] != 255;
+    }
+
+    MipChain mips;
+    mips.build(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+    stbi_image_free(pixels);
+
+    BakedTexture texture;
+    texture.build(mips, withAlpha ? BakedTexture::Format::BC3 : BakedTexture::Format::BC1);
+    if (!texture.save(baked.string()))
+    {
+      printf("%s: unable to write %s\n", image.filename().string().c_str(), baked.string().c_str());
+      ++failedCount;
+      continue;
+    }
+
+    printf("%s: %dx%d, %u levels, %s, %zu bytes instead of %zu\n", image.filename().string().c_str(), width, height,
+           texture.getLevelCount(), withAlpha ? "BC3" : "BC1", texture.getSize(), mips.getSize());
+    totalImageSize += mips.getSize();
+    totalBakedSize += texture.getSize();
+  }
+
+  printf("Baked %llu bytes of RGBA8 levels to %llu bytes\n", static_cast<unsigned long long>(totalImageSize),
+         static_cast<unsigned long long>(totalBakedSize));
+  return failedCount == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
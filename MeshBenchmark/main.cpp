@@ -0,0 +1,111 @@
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+// Runs the import time mesh processing on generated spheres of 20k, 180k and 500k triangles, whose triangles are
+// shuffled like a badly ordered model file. Reports the post-transform cache efficiency of the vertex cache
+// optimization (ACMR: vertices transformed per triangle, ATVR: per vertex) and how long it takes, then builds LODs
+// of each sphere the way the import does and reports their size, error and time. Run the Release build.
+
+// Latitude and longitude grid of a unit sphere, counter clockwise triangles facing outwards
+static void buildSphere(uint32_t segmentCount, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+  vertices.clear();
+  indices.clear();
+  for (uint32_t y = 0; y <= segmentCount; ++y)
+  {
+    for (uint32_t x = 0; x <= segmentCount; ++x)
+    {
+      float theta = x * 6.2831853f / segmentCount;
+      float phi = y * 3.1415927f / segmentCount;
+
+      Vertex vertex = {};
+      vertex.pos = glm::vec3(std::cos(theta) * std::sin(phi), std::cos(phi), std::sin(theta) * std::sin(phi));
+      vertex.tex = glm::vec2(static_cast<float>(x) / segmentCount, static_cast<float>(y) / segmentCount);
+      vertices.push_back(vertex);
+    }
+  }
+
+  for (uint32_t y = 0; y < segmentCount; ++y)
+  {
+    for (uint32_t x = 0; x < segmentCount; ++x)
+    {
+      uint32_t a = y * (segmentCount + 1) + x;
+      uint32_t c = a + segmentCount + 1;
+      indices.insert(indices.end(), { a, c, a + 1, a + 1, c, c + 1 });
+    }
+  }
+}
+
+static void shuffleTriangles(std::vector<uint32_t>& indices, std::mt19937& random)
+{
+  std::vector<std::array<uint32_t, 3>> triangles(indices.size() / 3);
+  for (size_t i = 0; i < triangles.size(); ++i)
+  {
+    triangles[i] = { indices[i * 3], indices[i * 3 + 1], indices[i * 3 + 2] };
+  }
+  std::shuffle(triangles.begin(), triangles.end(), random);
+  for (size_t i = 0; i < triangles.size(); ++i)
+  {
+    std::copy(triangles[i].begin(), triangles[i].end(), indices.begin() + i * 3);
+  }
+}
+
+int main()
+{
+  printf("Vertex cache optimization, %u entries FIFO\n", MeshOptimizer::CACHE_SIZE);
+  printf("%10s %10s %10s %10s %10s %10s\n", "triangles", "ACMR in", "ACMR out", "ATVR in", "ATVR out", "ms");
+
+  std::mt19937 random(1234);
+  const uint32_t segmentCounts[] = { 100, 300, 500 };
+  for (uint32_t segmentCount : segmentCounts)
+  {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    buildSphere(segmentCount, vertices, indices);
+    shuffleTriangles(indices, random);
+
+    MeshOptimizer::CacheStats before = MeshOptimizer::AnalyzeVertexCache(indices, vertices.size());
+    auto start = std::chrono::high_resolution_clock::now();
+    MeshOptimizer::Optimize(vertices, indices);
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    MeshOptimizer::CacheStats after = MeshOptimizer::AnalyzeVertexCache(indices, vertices.size());
+
+    printf("%10zu %10.3f %10.3f %10.3f %10.3f %10.1f\n", indices.size() / 3, before.getAcmr(), after.getAcmr(),
+           before.getAtvr(), after.getAtvr(), elapsed);
+  }
+
+  // Each LOD targets half the indices of the previous one, like MeshModel::BuildLods
+  printf("\nLOD simplification\n");
+  printf("%10s %10s %10s %10s %10s\n", "triangles", "lod", "indices", "error", "ms");
+  for (uint32_t segmentCount : segmentCounts)
+  {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    buildSphere(segmentCount, vertices, indices);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    MeshSimplifier simplifier(vertices, indices);
+    size_t targetIndexCount = indices.size();
+    for (uint32_t lod = 1; lod < MAX_MESH_LODS; ++lod)
+    {
+      targetIndexCount /= 2;
+      simplifier.simplify(targetIndexCount);
+      double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+      printf("%10zu %10u %10zu %10.5f %10.1f\n", indices.size() / 3, lod, simplifier.getIndexCount(), simplifier.getError(),
+             elapsed);
+    }
+  }
+
+  return 0;
+}
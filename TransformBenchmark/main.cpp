@@ -0,0 +1,133 @@
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "TransformBatch.h"
+
+// Compares the transform batch kernels with glm's operator* on 10k, 100k and 1M matrices: independent products
+// (result = a * b), then a hierarchy pass like the scene graph update (world = parent world * local).
+// Each measure is the best of several runs, in nanoseconds per matrix. Run the Release build.
+
+static const int RUN_COUNT = 10;
+
+template <typename Function>
+static double measure(size_t matrixCount, Function function)
+{
+  double best = 1e30;
+  for (int run = 0; run < RUN_COUNT; ++run)
+  {
+    auto start = std::chrono::high_resolution_clock::now();
+    function();
+    double elapsed = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+    best = std::min(best, elapsed);
+  }
+  return best / matrixCount;
+}
+
+static float maxDifference(const std::vector<glm::mat4>& a, const std::vector<glm::mat4>& b)
+{
+  float difference = 0.0f;
+  for (size_t i = 0; i < a.size(); ++i)
+  {
+    for (int column = 0; column < 4; ++column)
+    {
+      for (int row = 0; row < 4; ++row)
+      {
+        difference = std::max(difference, std::abs(a[i][column][row] - b[i][column][row]));
+      }
+    }
+  }
+  return difference;
+}
+
+// Rigid transform with a small scale, products stay in range along deep hierarchies
+static glm::mat4 randomTransform(std::mt19937& random)
+{
+  std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+  std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+  std::uniform_real_distribution<float> scale(0.9f, 1.1f);
+
+  float a = angle(random);
+  float s = scale(random);
+  glm::mat4 transform(1.0f);
+  transform[0] = glm::vec4(std::cos(a) * s, std::sin(a) * s, 0.0f, 0.0f);
+  transform[1] = glm::vec4(-std::sin(a) * s, std::cos(a) * s, 0.0f, 0.0f);
+  transform[2] = glm::vec4(0.0f, 0.0f, s, 0.0f);
+  transform[3] = glm::vec4(offset(random), offset(random), offset(random), 1.0f);
+  return transform;
+}
+
+int main()
+{
+  printf("Transform batch: %s\n", TransformBatch::GetInstructionSet());
+  printf("%10s %12s %12s %8s %12s %12s %8s\n", "matrices", "glm mul", "batch mul", "speedup",
+         "glm tree", "batch tree", "speedup");
+
+  std::mt19937 random(1234);
+  const size_t matrixCounts[] = { 10000, 100000, 1000000 };
+  for (size_t matrixCount : matrixCounts)
+  {
+    std::vector<glm::mat4> a(matrixCount);
+    std::vector<glm::mat4> b(matrixCount);
+    for (size_t i = 0; i < matrixCount; ++i)
+    {
+      a[i] = randomTransform(random);
+      b[i] = randomTransform(random);
+    }
+
+    // Parents first like the scene graph, a root every 100 nodes and the others under one of the previous 16
+    std::vector<int32_t> parents(matrixCount);
+    for (size_t i = 0; i < matrixCount; ++i)
+    {
+      parents[i] = i % 100 == 0 ? -1 : static_cast<int32_t>(i - 1 - random() % std::min<size_t>(i % 100, 16));
+    }
+
+    std::vector<glm::mat4> glmResult(matrixCount);
+    std::vector<glm::mat4> batchResult(matrixCount);
+
+    double glmMultiply = measure(matrixCount, [&]()
+    {
+      for (size_t i = 0; i < matrixCount; ++i)
+      {
+        glmResult[i] = a[i] * b[i];
+      }
+    });
+    double batchMultiply = measure(matrixCount, [&]()
+    {
+      TransformBatch::Multiply(a.data(), b.data(), batchResult.data(), matrixCount);
+    });
+    float multiplyDifference = maxDifference(glmResult, batchResult);
+
+    double glmTree = measure(matrixCount, [&]()
+    {
+      for (size_t i = 0; i < matrixCount; ++i)
+      {
+        glmResult[i] = parents[i] < 0 ? b[i] : glmResult[parents[i]] * b[i];
+      }
+    });
+    double batchTree = measure(matrixCount, [&]()
+    {
+      TransformBatch::MultiplyHierarchy(parents.data(), b.data(), batchResult.data(), 0, matrixCount);
+    });
+    float treeDifference = maxDifference(glmResult, batchResult);
+
+    printf("%10zu %9.2f ns %9.2f ns %7.2fx %9.2f ns %9.2f ns %7.2fx\n", matrixCount,
+           glmMultiply, batchMultiply, glmMultiply / batchMultiply, glmTree, batchTree, glmTree / batchTree);
+
+    // Only the order of the additions differs from glm
+    if (multiplyDifference > 1e-3f || treeDifference > 1e-3f)
+    {
+      printf("Results differ from glm: %g, %g\n", multiplyDifference, treeDifference);
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
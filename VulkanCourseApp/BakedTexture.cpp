@@ -0,0 +1,149 @@
+#include "BakedTexture.h"
+
+#include "BlockCompressor.h"
+#include "MipChain.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+static const uint32_t MAX_LEVELS = 32;
+
+static uint64_t alignOffset(uint64_t offset)
+{
+  return (offset + 15) & ~uint64_t(15);
+}
+
+bool BakedTexture::IsBaked(const unsigned char* fileData, size_t fileSize)
+{
+  uint32_t magic = 0;
+  if (fileSize >= sizeof(Header))
+  {
+    memcpy(&magic, fileData, sizeof(magic));
+  }
+  return magic == MAGIC;
+}
+
+void BakedTexture::build(const MipChain& mips, Format newFormat)
+{
+  format = newFormat;
+  levels.resize(mips.getLevelCount());
+
+  uint64_t size = 0;
+  for (uint32_t i = 0; i < levels.size(); ++i)
+  {
+    const MipChain::Level& mip = mips.getLevel(i);
+    levels[i].width = mip.width;
+    levels[i].height = mip.height;
+    levels[i].offset = alignOffset(size);
+    levels[i].size = LevelSize(format, mip.width, mip.height);
+    size = levels[i].offset + levels[i].size;
+  }
+  data.assign(static_cast<size_t>(size), 0);
+
+  for (uint32_t i = 0; i < levels.size(); ++i)
+  {
+    const MipChain::Level& mip = mips.getLevel(i);
+    const unsigned char* pixels = mips.getData() + mip.offset;
+    unsigned char* levelData = data.data() + levels[i].offset;
+    if (format == Format::RGBA8)
+    {
+      memcpy(levelData, pixels, static_cast<size_t>(levels[i].size));
+    }
+    else
+    {
+      BlockCompressor::CompressImage(pixels, mip.width, mip.height, format == Format::BC3, levelData);
+    }
+  }
+}
+
+bool BakedTexture::load(const unsigned char* fileData, size_t fileSize)
+{
+  if (!IsBaked(fileData, fileSize))
+  {
+    return false;
+  }
+
+  Header header;
+  memcpy(&header, fileData, sizeof(Header));
+  if (header.version != VERSION || header.format > static_cast<uint32_t>(Format::BC3) ||
+      header.levelCount == 0 || header.levelCount > MAX_LEVELS)
+  {
+    return false;
+  }
+
+  size_t dataOffset = sizeof(Header) + header.levelCount * sizeof(Level);
+  if (fileSize < dataOffset)
+  {
+    return false;
+  }
+
+  std::vector<Level> newLevels(header.levelCount);
+  memcpy(newLevels.data(), fileData + sizeof(Header), header.levelCount * sizeof(Level));
+
+  // Levels must be a mip chain and stay inside of the file, the upload copies them without further checks.
+  // Their size must be the one of their extent, the copy to the image reads that many bytes.
+  const Format newFormat = static_cast<Format>(header.format);
+  if (newLevels[0].width == 0 || newLevels[0].height == 0 ||
+      header.levelCount > MipChain::LevelCount(newLevels[0].width, newLevels[0].height))
+  {
+    return false;
+  }
+
+  size_t dataSize = fileSize - dataOffset;
+  for (uint32_t i = 0; i < header.levelCount; ++i)
+  {
+    const Level& level = newLevels[i];
+    if (i > 0 && (level.width != std::max(newLevels[i - 1].width >> 1, 1u) ||
+                  level.height != std::max(newLevels[i - 1].height >> 1, 1u)))
+    {
+      return false;
+    }
+
+    if (level.size != LevelSize(newFormat, level.width, level.height) || level.offset % 16 != 0 ||
+        level.offset > dataSize || level.size > dataSize - level.offset)
+    {
+      return false;
+    }
+  }
+
+  format = newFormat;
+  levels.swap(newLevels);
+  data.assign(fileData + dataOffset, fileData + fileSize);
+  return true;
+}
+
+uint64_t BakedTexture::LevelSize(Format levelFormat, uint32_t width, uint32_t height)
+{
+  if (levelFormat == Format::RGBA8)
+  {
+    return static_cast<uint64_t>(width) * height * 4;
+  }
+  return BlockCompressor::CompressedSize(width, height, levelFormat == Format::BC3);
+}
+
+bool BakedTexture::save(const std::string& filename) const
+{
+  if (levels.empty())
+  {
+    return false;
+  }
+
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  Header header = {};
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.format = static_cast<uint32_t>(format);
+  header.levelCount = static_cast<uint32_t>(levels.size());
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  file.write(reinterpret_cast<const char*>(levels.data()), levels.size() * sizeof(Level));
+  file.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+  return file.good();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class MipChain;
+
+// Texture baked offline by the AssetBaker: every level of its mip chain, block compressed or not, stored the way
+// it is uploaded. The file is a header, the table of levels and their data, so loading it is a copy to the staging
+// buffer without any decoding. The same layout holds the textures decoded at load time, uncompressed.
+class BakedTexture
+{
+public:
+  static const uint32_t MAGIC = 0x58544B42;     // "BKTX"
+  static const uint32_t VERSION = 1;
+
+  enum class Format : uint32_t
+  {
+    RGBA8 = 0,
+    BC1 = 1,          // RGB, 4 bits per texel
+    BC3 = 2,          // RGBA, 8 bits per texel
+  };
+
+  struct Level
+  {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;    // From the start of the level data, 16 bytes aligned
+    uint64_t size;
+  };
+
+  static bool IsBaked(const unsigned char* fileData, size_t fileSize);
+
+  // Encode the levels of a mip chain
+  void build(const MipChain& mips, Format newFormat);
+
+  // Content of a baked file, false if it isn't a valid baked texture of this version
+  bool load(const unsigned char* fileData, size_t fileSize);
+  bool save(const std::string& filename) const;
+
+  Format getFormat() const { return format; }
+  uint32_t getLevelCount() const { return static_cast<uint32_t>(levels.size()); }
+  const Level& getLevel(uint32_t index) const { assert(index < levels.size()); return levels[index]; }
+  const unsigned char* getData() const { return data.data(); }
+  size_t getSize() const { return data.size(); }
+
+private:
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t levelCount;
+  };
+
+  // Bytes of a level of the format, blocks cover 4x4 texels
+  static uint64_t LevelSize(Format levelFormat, uint32_t width, uint32_t height);
+
+  Format format = Format::RGBA8;
+  std::vector<Level> levels;
+  std::vector<unsigned char> data;
+};
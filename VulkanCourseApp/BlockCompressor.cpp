@@ -0,0 +1,234 @@
+#include "BlockCompressor.h"
+
+#include <algorithm>
+#include <cmath>
+
+static uint16_t packColor(const float color[3])
+{
+  int r = std::min(std::max(static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f), 0), 31);
+  int g = std::min(std::max(static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f), 0), 63);
+  int b = std::min(std::max(static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f), 0), 31);
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void unpackColor(uint16_t packed, int color[3])
+{
+  int r = (packed >> 11) & 31;
+  int g = (packed >> 5) & 63;
+  int b = packed & 31;
+  color[0] = (r << 3) | (r >> 2);
+  color[1] = (g << 2) | (g >> 4);
+  color[2] = (b << 3) | (b >> 2);
+}
+
+// 565 endpoints and 2 bits indices, always in the 4 colors mode
+static void compressColor(const unsigned char texels[64], unsigned char* block)
+{
+  float mean[3] = { 0.0f, 0.0f, 0.0f };
+  for (int i = 0; i < 16; ++i)
+  {
+    for (int c = 0; c < 3; ++c)
+    {
+      mean[c] += texels[i * 4 + c];
+    }
+  }
+  for (int c = 0; c < 3; ++c)
+  {
+    mean[c] /= 16.0f;
+  }
+
+  // Covariance of the colors, its principal eigenvector found by power iteration is the fitting axis
+  float cov[3][3] = {};
+  for (int i = 0; i < 16; ++i)
+  {
+    float d[3] = { texels[i * 4] - mean[0], texels[i * 4 + 1] - mean[1], texels[i * 4 + 2] - mean[2] };
+    for (int a = 0; a < 3; ++a)
+    {
+      for (int b = 0; b < 3; ++b)
+      {
+        cov[a][b] += d[a] * d[b];
+      }
+    }
+  }
+
+  float axis[3] = { 1.0f, 1.0f, 1.0f };
+  for (int iteration = 0; iteration < 8; ++iteration)
+  {
+    float next[3];
+    for (int a = 0; a < 3; ++a)
+    {
+      next[a] = cov[a][0] * axis[0] + cov[a][1] * axis[1] + cov[a][2] * axis[2];
+    }
+    float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+    if (length < 1e-6f)
+    {
+      break;
+    }
+    for (int a = 0; a < 3; ++a)
+    {
+      axis[a] = next[a] / length;
+    }
+  }
+
+  // Endpoints are the extreme projections on the axis
+  float minT = 0.0f, maxT = 0.0f;
+  for (int i = 0; i < 16; ++i)
+  {
+    float t = (texels[i * 4] - mean[0]) * axis[0] + (texels[i * 4 + 1] - mean[1]) * axis[1] +
+              (texels[i * 4 + 2] - mean[2]) * axis[2];
+    minT = std::min(minT, t);
+    maxT = std::max(maxT, t);
+  }
+
+  float end0[3], end1[3];
+  for (int c = 0; c < 3; ++c)
+  {
+    end0[c] = mean[c] + axis[c] * maxT;
+    end1[c] = mean[c] + axis[c] * minT;
+  }
+
+  uint16_t color0 = packColor(end0);
+  uint16_t color1 = packColor(end1);
+  if (color0 < color1)
+  {
+    std::swap(color0, color1);
+  }
+
+  uint32_t indices = 0;
+  if (color0 != color1)
+  {
+    int palette[4][3];
+    unpackColor(color0, palette[0]);
+    unpackColor(color1, palette[1]);
+    for (int c = 0; c < 3; ++c)
+    {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    for (int i = 0; i < 16; ++i)
+    {
+      int best = 0;
+      int bestDistance = 0x7fffffff;
+      for (int p = 0; p < 4; ++p)
+      {
+        int dr = texels[i * 4] - palette[p][0];
+        int dg = texels[i * 4 + 1] - palette[p][1];
+        int db = texels[i * 4 + 2] - palette[p][2];
+        int distance = dr * dr + dg * dg + db * db;
+        if (distance < bestDistance)
+        {
+          best = p;
+          bestDistance = distance;
+        }
+      }
+      indices |= static_cast<uint32_t>(best) << (2 * i);
+    }
+  }
+
+  block[0] = static_cast<unsigned char>(color0 & 0xff);
+  block[1] = static_cast<unsigned char>(color0 >> 8);
+  block[2] = static_cast<unsigned char>(color1 & 0xff);
+  block[3] = static_cast<unsigned char>(color1 >> 8);
+  for (int i = 0; i < 4; ++i)
+  {
+    block[4 + i] = static_cast<unsigned char>(indices >> (8 * i));
+  }
+}
+
+// 8 bits endpoints and 3 bits indices, in the 8 alphas mode
+static void compressAlpha(const unsigned char texels[64], unsigned char* block)
+{
+  int alpha0 = 0, alpha1 = 255;
+  for (int i = 0; i < 16; ++i)
+  {
+    alpha0 = std::max(alpha0, static_cast<int>(texels[i * 4 + 3]));
+    alpha1 = std::min(alpha1, static_cast<int>(texels[i * 4 + 3]));
+  }
+
+  uint64_t indices = 0;
+  if (alpha0 != alpha1)
+  {
+    int palette[8];
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+    for (int i = 1; i < 7; ++i)
+    {
+      palette[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+    }
+
+    for (int i = 0; i < 16; ++i)
+    {
+      int best = 0;
+      int bestDistance = 256;
+      for (int p = 0; p < 8; ++p)
+      {
+        int distance = std::abs(texels[i * 4 + 3] - palette[p]);
+        if (distance < bestDistance)
+        {
+          best = p;
+          bestDistance = distance;
+        }
+      }
+      indices |= static_cast<uint64_t>(best) << (3 * i);
+    }
+  }
+
+  block[0] = static_cast<unsigned char>(alpha0);
+  block[1] = static_cast<unsigned char>(alpha1);
+  for (int i = 0; i < 6; ++i)
+  {
+    block[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+  }
+}
+
+void BlockCompressor::CompressBC1(const unsigned char texels[64], unsigned char* block)
+{
+  compressColor(texels, block);
+}
+
+void BlockCompressor::CompressBC3(const unsigned char texels[64], unsigned char* block)
+{
+  compressAlpha(texels, block);
+  compressColor(texels, block + 8);
+}
+
+void BlockCompressor::CompressImage(const unsigned char* pixels, uint32_t width, uint32_t height, bool withAlpha,
+                                    unsigned char* blocks)
+{
+  const uint32_t blockSize = withAlpha ? BC3_BLOCK_SIZE : BC1_BLOCK_SIZE;
+  unsigned char texels[64];
+
+  for (uint32_t blockY = 0; blockY < height; blockY += 4)
+  {
+    for (uint32_t blockX = 0; blockX < width; blockX += 4)
+    {
+      for (uint32_t y = 0; y < 4; ++y)
+      {
+        uint32_t srcY = std::min(blockY + y, height - 1);
+        for (uint32_t x = 0; x < 4; ++x)
+        {
+          uint32_t srcX = std::min(blockX + x, width - 1);
+          const unsigned char* texel = pixels + (static_cast<size_t>(srcY) * width + srcX) * 4;
+          std::copy(texel, texel + 4, texels + (y * 4 + x) * 4);
+        }
+      }
+
+      if (withAlpha)
+      {
+        CompressBC3(texels, blocks);
+      }
+      else
+      {
+        CompressBC1(texels, blocks);
+      }
+      blocks += blockSize;
+    }
+  }
+}
+
+size_t BlockCompressor::CompressedSize(uint32_t width, uint32_t height, bool withAlpha)
+{
+  size_t blockCount = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+  return blockCount * (withAlpha ? BC3_BLOCK_SIZE : BC1_BLOCK_SIZE);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// BC1 and BC3 encoding of 4x4 texel blocks, used by the asset baker. Color endpoints are fitted along the
+// principal axis of the block colors: fast, and close enough to an exhaustive search for color textures.
+class BlockCompressor
+{
+public:
+  static const uint32_t BC1_BLOCK_SIZE = 8;
+  static const uint32_t BC3_BLOCK_SIZE = 16;
+
+  // Texels of the block are RGBA8, row by row
+  static void CompressBC1(const unsigned char texels[64], unsigned char* block);
+  static void CompressBC3(const unsigned char texels[64], unsigned char* block);
+
+  // Blocks of a whole RGBA8 image, row by row. The blocks on the edges repeat the last row and column.
+  static void CompressImage(const unsigned char* pixels, uint32_t width, uint32_t height, bool withAlpha,
+                            unsigned char* blocks);
+  static size_t CompressedSize(uint32_t width, uint32_t height, bool withAlpha);
+};
@@ -0,0 +1,70 @@
+#include "ClusterCuller.h"
+
+#include <array>
+#include <cstring>
+
+ClusterCuller::ClusterCuller()
+: meshletBuffer(VK_NULL_HANDLE)
+{
+}
+
+ClusterCuller::~ClusterCuller()
+{
+}
+
+void ClusterCuller::init(VkDevice newDevice, const std::string& shaderFile, VkAllocationCallbacks* a_pAllocCB)
+{
+  // Objects, cluster draws, commands, counts and instance indices in the frame data, then the arena meshlets
+  pass.init(newDevice, shaderFile, 5, 1, sizeof(CullParams), a_pAllocCB);
+}
+
+void ClusterCuller::destroy()
+{
+  pass.destroy();
+  meshletBuffer = VK_NULL_HANDLE;
+}
+
+void ClusterCuller::setBuffer(VkBuffer buffer)
+{
+  pass.setDynamicBuffer(buffer);
+}
+
+void ClusterCuller::setMeshletBuffer(VkBuffer buffer)
+{
+  if (buffer == meshletBuffer)
+  {
+    return;
+  }
+
+  pass.setBuffer(5, buffer);
+  meshletBuffer = buffer;
+}
+
+void ClusterCuller::record(VkCommandBuffer commandBuffer,
+                           const glm::vec4 planes[6],
+                           const glm::vec3& eye,
+                           uint32_t drawCount,
+                           uint32_t objectsOffset,
+                           uint32_t drawsOffset,
+                           uint32_t commandsOffset,
+                           uint32_t countsOffset,
+                           uint32_t instanceIndicesOffset)
+{
+  CullParams params;
+  memcpy(params.planes, planes, sizeof(params.planes));
+  params.eye = glm::vec4(eye, 1.0f);
+  params.drawCount = drawCount;
+
+  std::array<uint32_t, 5> dynamicOffsets = { objectsOffset, drawsOffset, commandsOffset, countsOffset, instanceIndicesOffset };
+
+  pass.bind(commandBuffer, dynamicOffsets.data(), &params);
+
+  // Instances past the group count limit of a dimension go on the next row
+  uint32_t groupCountX = drawCount > MAX_GROUPS_X ? MAX_GROUPS_X : drawCount;
+  if (groupCountX > 0)
+  {
+    vkCmdDispatch(commandBuffer, groupCountX, (drawCount + groupCountX - 1) / groupCountX, 1);
+  }
+
+  ComputePass::RecordOutputBarrier(commandBuffer);
+}
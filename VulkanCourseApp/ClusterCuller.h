@@ -0,0 +1,73 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+
+#include "ComputePass.h"
+#include "Utilities.h"
+
+// Compute pass culling the meshlets of every instance before the render pass: the instance is tested against the
+// view frustum, then each of its meshlets against the frustum and its normal cone. Every meshlet left becomes an
+// indirect draw command of its group, so partially visible meshes only draw their visible clusters.
+// Like the instance culling pass, its inputs and outputs are sub-allocations of a single buffer selected with dynamic
+// offsets, only the meshlets live in the geometry arena.
+class ClusterCuller
+{
+public:
+  // Per instance input of the culling pass, std430 layout
+  struct ClusterDraw
+  {
+    glm::vec4 sphere;               // Model space center and radius of the mesh
+    uint32_t objectIndex;           // Index of the object data
+    uint32_t firstMeshlet;          // Meshlets in the arena buffer, none if the LOD drawn isn't the full detail one
+    uint32_t meshletCount;
+    uint32_t firstIndex;            // Indices drawn with a single command when the instance has no meshlet
+    uint32_t indexCount;
+    int32_t vertexOffset;
+    uint32_t groupIndex;            // The group's draw count is counts[groupIndex + 1]
+    uint32_t firstCommand;          // First of the group's commands
+  };
+
+  ClusterCuller();
+  ~ClusterCuller();
+
+  // Throws if the shader can't be read or the pipeline can't be created
+  void init(VkDevice newDevice, const std::string& shaderFile, VkAllocationCallbacks* a_pAllocCB = nullptr);
+  void destroy();
+
+  // Buffer holding the culling data, must be set again when it is recreated
+  void setBuffer(VkBuffer buffer);
+
+  // Arena meshlet buffer, updated only when it changed. The arena waits for the device when it replaces it.
+  void setMeshletBuffer(VkBuffer buffer);
+
+  // Record the dispatch and the barrier making its output visible to indirect draws and to the host.
+  // The group counts and counts[0] must be zeroed before submitting: every visible meshlet increments its group's count
+  // and writes the command and instance index at that position of the group's commands, and every visible instance
+  // increments counts[0].
+  void record(VkCommandBuffer commandBuffer,
+              const glm::vec4 planes[6],
+              const glm::vec3& eye,
+              uint32_t drawCount,
+              uint32_t objectsOffset,
+              uint32_t drawsOffset,
+              uint32_t commandsOffset,
+              uint32_t countsOffset,
+              uint32_t instanceIndicesOffset);
+
+private:
+  struct CullParams
+  {
+    glm::vec4 planes[6];
+    glm::vec4 eye;
+    uint32_t drawCount;
+  };
+
+  // One work group per instance, its threads go through the meshlets
+  static const uint32_t MAX_GROUPS_X = 65535;
+
+  ComputePass pass;
+  VkBuffer meshletBuffer;
+};
@@ -0,0 +1,227 @@
+#include "ComputePass.h"
+
+#include <stdexcept>
+#include <vector>
+
+ComputePass::ComputePass()
+: device(VK_NULL_HANDLE)
+, m_pAllocCB(nullptr)
+, dynamicBufferCount(0)
+, pushConstantSize(0)
+, setLayout(VK_NULL_HANDLE)
+, descriptorPool(VK_NULL_HANDLE)
+, descriptorSet(VK_NULL_HANDLE)
+, pipelineLayout(VK_NULL_HANDLE)
+, pipeline(VK_NULL_HANDLE)
+{
+}
+
+ComputePass::~ComputePass()
+{
+}
+
+void ComputePass::init(VkDevice newDevice,
+                       const std::string& shaderFile,
+                       uint32_t newDynamicBufferCount,
+                       uint32_t bufferCount,
+                       uint32_t newPushConstantSize,
+                       VkAllocationCallbacks* a_pAllocCB)
+{
+  device = newDevice;
+  m_pAllocCB = a_pAllocCB;
+  dynamicBufferCount = newDynamicBufferCount;
+  pushConstantSize = newPushConstantSize;
+
+  // Read before creating anything, a missing shader leaves nothing to destroy
+  auto shaderCode = readFile(shaderFile);
+
+  std::vector<VkDescriptorSetLayoutBinding> layoutBindings(dynamicBufferCount + bufferCount);
+  for (uint32_t i = 0; i < layoutBindings.size(); ++i)
+  {
+    layoutBindings[i].binding = i;
+    layoutBindings[i].descriptorType = i < dynamicBufferCount ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    layoutBindings[i].descriptorCount = 1;
+    layoutBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    layoutBindings[i].pImmutableSamplers = nullptr;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+  layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutCreateInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
+  layoutCreateInfo.pBindings = layoutBindings.data();
+
+  if (vkCreateDescriptorSetLayout(device, &layoutCreateInfo, m_pAllocCB, &setLayout) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create compute descriptor set layout");
+  }
+
+  // Pool sizes can't have a zero descriptor count
+  std::vector<VkDescriptorPoolSize> poolSizes;
+  if (dynamicBufferCount > 0)
+  {
+    poolSizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, dynamicBufferCount });
+  }
+  if (bufferCount > 0)
+  {
+    poolSizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferCount });
+  }
+
+  VkDescriptorPoolCreateInfo poolCreateInfo = {};
+  poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolCreateInfo.maxSets = 1;
+  poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolCreateInfo.pPoolSizes = poolSizes.data();
+
+  if (vkCreateDescriptorPool(device, &poolCreateInfo, m_pAllocCB, &descriptorPool) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create compute descriptor pool");
+  }
+
+  VkDescriptorSetAllocateInfo setAllocInfo = {};
+  setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  setAllocInfo.descriptorPool = descriptorPool;
+  setAllocInfo.descriptorSetCount = 1;
+  setAllocInfo.pSetLayouts = &setLayout;
+
+  if (vkAllocateDescriptorSets(device, &setAllocInfo, &descriptorSet) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to allocate compute descriptor set");
+  }
+
+  VkPushConstantRange pushConstantRange = {};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = pushConstantSize;
+
+  VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+  pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutCreateInfo.setLayoutCount = 1;
+  pipelineLayoutCreateInfo.pSetLayouts = &setLayout;
+  pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+  pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, m_pAllocCB, &pipelineLayout) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create compute pipeline layout");
+  }
+
+  VkShaderModuleCreateInfo shaderCreateInfo = {};
+  shaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  shaderCreateInfo.codeSize = shaderCode.size();
+  shaderCreateInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(device, &shaderCreateInfo, m_pAllocCB, &shaderModule) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create compute shader module");
+  }
+
+  VkComputePipelineCreateInfo pipelineCreateInfo = {};
+  pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineCreateInfo.stage.module = shaderModule;
+  pipelineCreateInfo.stage.pName = "main";
+  pipelineCreateInfo.layout = pipelineLayout;
+
+  VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, m_pAllocCB, &pipeline);
+  vkDestroyShaderModule(device, shaderModule, m_pAllocCB);
+
+  if (result != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create compute pipeline");
+  }
+}
+
+void ComputePass::destroy()
+{
+  if (pipeline != VK_NULL_HANDLE)
+  {
+    vkDestroyPipeline(device, pipeline, m_pAllocCB);
+    pipeline = VK_NULL_HANDLE;
+  }
+  if (pipelineLayout != VK_NULL_HANDLE)
+  {
+    vkDestroyPipelineLayout(device, pipelineLayout, m_pAllocCB);
+    pipelineLayout = VK_NULL_HANDLE;
+  }
+  if (descriptorPool != VK_NULL_HANDLE)
+  {
+    vkDestroyDescriptorPool(device, descriptorPool, m_pAllocCB);
+    descriptorPool = VK_NULL_HANDLE;
+    descriptorSet = VK_NULL_HANDLE;
+  }
+  if (setLayout != VK_NULL_HANDLE)
+  {
+    vkDestroyDescriptorSetLayout(device, setLayout, m_pAllocCB);
+    setLayout = VK_NULL_HANDLE;
+  }
+}
+
+void ComputePass::setDynamicBuffer(VkBuffer buffer)
+{
+  // The dynamic offsets select the arrays
+  VkDescriptorBufferInfo bufferInfo = {};
+  bufferInfo.buffer = buffer;
+  bufferInfo.offset = 0;
+  bufferInfo.range = VK_WHOLE_SIZE;
+
+  std::vector<VkWriteDescriptorSet> setWrites(dynamicBufferCount);
+  for (uint32_t i = 0; i < setWrites.size(); ++i)
+  {
+    setWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    setWrites[i].dstSet = descriptorSet;
+    setWrites[i].dstBinding = i;
+    setWrites[i].dstArrayElement = 0;
+    setWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    setWrites[i].descriptorCount = 1;
+    setWrites[i].pBufferInfo = &bufferInfo;
+  }
+
+  vkUpdateDescriptorSets(device, static_cast<uint32_t>(setWrites.size()), setWrites.data(), 0, nullptr);
+}
+
+void ComputePass::setBuffer(uint32_t binding, VkBuffer buffer)
+{
+  VkDescriptorBufferInfo bufferInfo = {};
+  bufferInfo.buffer = buffer;
+  bufferInfo.offset = 0;
+  bufferInfo.range = VK_WHOLE_SIZE;
+
+  VkWriteDescriptorSet setWrite = {};
+  setWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  setWrite.dstSet = descriptorSet;
+  setWrite.dstBinding = binding;
+  setWrite.dstArrayElement = 0;
+  setWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  setWrite.descriptorCount = 1;
+  setWrite.pBufferInfo = &bufferInfo;
+
+  vkUpdateDescriptorSets(device, 1, &setWrite, 0, nullptr);
+}
+
+void ComputePass::bind(VkCommandBuffer commandBuffer, const uint32_t* dynamicOffsets, const void* pushConstants)
+{
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0,
+                          1, &descriptorSet, dynamicBufferCount, dynamicOffsets);
+  vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pushConstantSize, pushConstants);
+}
+
+void ComputePass::RecordOutputBarrier(VkCommandBuffer commandBuffer)
+{
+  // Commands and counts are read by the indirect draws, instance indices by the vertex shader,
+  // and the visible count by the host once the frame fence signals
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+
+  vkCmdPipelineBarrier(commandBuffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                       0,
+                       1, &barrier,
+                       0, nullptr,
+                       0, nullptr);
+}
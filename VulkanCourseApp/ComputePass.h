@@ -0,0 +1,50 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+
+#include "Utilities.h"
+
+// Compute pipeline with a single descriptor set of storage buffers and a push constant block, shared by the culling
+// passes. The first bindings are dynamic storage buffers over one buffer, selected with dynamic offsets when binding,
+// the ones after them are plain storage buffers set one by one.
+class ComputePass
+{
+public:
+  ComputePass();
+  ~ComputePass();
+
+  // Throws if the shader can't be read or the pipeline can't be created
+  void init(VkDevice newDevice,
+            const std::string& shaderFile,
+            uint32_t newDynamicBufferCount,
+            uint32_t bufferCount,
+            uint32_t newPushConstantSize,
+            VkAllocationCallbacks* a_pAllocCB = nullptr);
+  void destroy();
+
+  // Every dynamic binding sees the whole buffer, must be set again when it is recreated
+  void setDynamicBuffer(VkBuffer buffer);
+  // Binding past the dynamic ones
+  void setBuffer(uint32_t binding, VkBuffer buffer);
+
+  // Bind the pipeline and the descriptor set with one offset per dynamic binding, and push the constants
+  void bind(VkCommandBuffer commandBuffer, const uint32_t* dynamicOffsets, const void* pushConstants);
+
+  // Make the pass output visible to indirect draws, to the vertex shader and to the host
+  static void RecordOutputBarrier(VkCommandBuffer commandBuffer);
+
+private:
+  VkDevice device;
+  VkAllocationCallbacks* m_pAllocCB;
+  uint32_t dynamicBufferCount;
+  uint32_t pushConstantSize;
+
+  VkDescriptorSetLayout setLayout;
+  VkDescriptorPool descriptorPool;
+  VkDescriptorSet descriptorSet;
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipeline;
+};
@@ -0,0 +1,96 @@
+#include "CpuCuller.h"
+
+#include "CpuFeatures.h"
+
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPU_CULLER_SSE
+#include <emmintrin.h>
+#endif
+
+void CpuCuller::resize(size_t newCount)
+{
+  count = newCount;
+
+  // Padding spheres have a negative infinite radius, they are outside of every plane
+  size_t paddedCount = (count + BATCH_SIZE - 1) / BATCH_SIZE * BATCH_SIZE;
+  centerX.resize(paddedCount);
+  centerY.resize(paddedCount);
+  centerZ.resize(paddedCount);
+  radii.resize(paddedCount);
+  for (size_t i = count; i < paddedCount; ++i)
+  {
+    centerX[i] = 0.0f;
+    centerY[i] = 0.0f;
+    centerZ[i] = 0.0f;
+    radii[i] = -FLT_MAX;
+  }
+}
+
+void CpuCuller::cull(const glm::vec4 planes[6], std::vector<uint32_t>& visible) const
+{
+  visible.clear();
+
+#if defined(CPU_FEATURES_X86)
+  if (CpuFeatures::HasAvx2())
+  {
+    cullAvx2(planes, visible);
+    return;
+  }
+#endif
+
+  size_t paddedCount = radii.size();
+
+#if defined(CPU_CULLER_SSE)
+  __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+  for (int p = 0; p < 6; ++p)
+  {
+    planeX[p] = _mm_set1_ps(planes[p].x);
+    planeY[p] = _mm_set1_ps(planes[p].y);
+    planeZ[p] = _mm_set1_ps(planes[p].z);
+    planeW[p] = _mm_set1_ps(planes[p].w);
+  }
+
+  for (size_t i = 0; i < paddedCount; i += 4)
+  {
+    __m128 x = _mm_loadu_ps(&centerX[i]);
+    __m128 y = _mm_loadu_ps(&centerY[i]);
+    __m128 z = _mm_loadu_ps(&centerZ[i]);
+    __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radii[i]));
+
+    // Inside unless the center is further than the radius behind one of the planes
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < 6; ++p)
+    {
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+                                   _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+    }
+
+    int mask = _mm_movemask_ps(inside);
+    for (int lane = 0; mask != 0; ++lane, mask >>= 1)
+    {
+      if (mask & 1)
+      {
+        visible.push_back(static_cast<uint32_t>(i + lane));
+      }
+    }
+  }
+#else
+  for (size_t i = 0; i < paddedCount; ++i)
+  {
+    bool inside = true;
+    for (int p = 0; p < 6 && inside; ++p)
+    {
+      float distance = planes[p].x * centerX[i] + planes[p].y * centerY[i] + planes[p].z * centerZ[i] + planes[p].w;
+      inside = distance >= -radii[i];
+    }
+
+    if (inside)
+    {
+      visible.push_back(static_cast<uint32_t>(i));
+    }
+  }
+#endif
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Frustum culling of bounding spheres on the CPU, for when the culling pass can't run on the GPU.
+// Spheres are stored as structure of arrays so each plane test works on full registers:
+// 8 spheres per iteration with AVX2 (picked at run time), 4 with SSE, one at a time otherwise.
+class CpuCuller
+{
+public:
+  // Number of spheres per iteration of the widest path, storage is padded to a multiple of it
+  static const size_t BATCH_SIZE = 8;
+
+  // Spheres past the new count are undefined until set
+  void resize(size_t newCount);
+  size_t size() const { return count; }
+
+  // World space sphere
+  void setSphere(size_t index, const glm::vec3& center, float radius)
+  {
+    centerX[index] = center.x;
+    centerY[index] = center.y;
+    centerZ[index] = center.z;
+    radii[index] = radius;
+  }
+
+  // Indices of the spheres intersecting the frustum, in increasing order.
+  // Planes point inside and are normalized, as returned by getFrustumPlanes().
+  void cull(const glm::vec4 planes[6], std::vector<uint32_t>& visible) const;
+
+private:
+  size_t count = 0;
+  std::vector<float> centerX;
+  std::vector<float> centerY;
+  std::vector<float> centerZ;
+  std::vector<float> radii;
+
+  // CpuCullerAvx2.cpp, only called when the CPU has AVX2
+  void cullAvx2(const glm::vec4 planes[6], std::vector<uint32_t>& visible) const;
+};
@@ -0,0 +1,54 @@
+#include "CpuCuller.h"
+
+#include "CpuFeatures.h"
+
+#if defined(CPU_FEATURES_X86)
+#include <immintrin.h>
+
+// The project builds this file with /arch:AVX2, GCC and Clang get the target per function
+#if defined(__GNUC__) && !defined(__AVX2__)
+#define CPU_CULLER_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define CPU_CULLER_AVX2_TARGET
+#endif
+
+CPU_CULLER_AVX2_TARGET void CpuCuller::cullAvx2(const glm::vec4 planes[6], std::vector<uint32_t>& visible) const
+{
+  size_t paddedCount = radii.size();
+
+  __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+  for (int p = 0; p < 6; ++p)
+  {
+    planeX[p] = _mm256_set1_ps(planes[p].x);
+    planeY[p] = _mm256_set1_ps(planes[p].y);
+    planeZ[p] = _mm256_set1_ps(planes[p].z);
+    planeW[p] = _mm256_set1_ps(planes[p].w);
+  }
+
+  for (size_t i = 0; i < paddedCount; i += 8)
+  {
+    __m256 x = _mm256_loadu_ps(&centerX[i]);
+    __m256 y = _mm256_loadu_ps(&centerY[i]);
+    __m256 z = _mm256_loadu_ps(&centerZ[i]);
+    __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&radii[i]));
+
+    // Inside unless the center is further than the radius behind one of the planes
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int p = 0; p < 6; ++p)
+    {
+      __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+                                      _mm256_add_ps(_mm256_mul_ps(planeZ[p], z), planeW[p]));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+    }
+
+    int mask = _mm256_movemask_ps(inside);
+    for (int lane = 0; mask != 0; ++lane, mask >>= 1)
+    {
+      if (mask & 1)
+      {
+        visible.push_back(static_cast<uint32_t>(i + lane));
+      }
+    }
+  }
+}
+#endif
@@ -0,0 +1,41 @@
+#include "CpuFeatures.h"
+
+#if defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static bool detectAvx2()
+{
+#if defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+  {
+    return false;
+  }
+
+  // AVX and OSXSAVE, then the XMM and YMM state enabled by the OS
+  __cpuid(info, 1);
+  const int osxsaveAvx = (1 << 27) | (1 << 28);
+  if ((info[2] & osxsaveAvx) != osxsaveAvx || (_xgetbv(0) & 0x6) != 0x6)
+  {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#elif defined(CPU_FEATURES_X86) && defined(__GNUC__)
+  // Also checks that the OS saves the registers
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#else
+  return false;
+#endif
+}
+
+bool CpuFeatures::HasAvx2()
+{
+  static const bool hasAvx2 = detectAvx2();
+  return hasAvx2;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+// x86 builds carry AVX2 kernels next to their SSE ones. The AVX2 kernels live in their own files, which are the only
+// ones compiled with AVX2 code generation, and are only called when the CPU supports AVX2.
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CPU_FEATURES_X86
+#endif
+
+class CpuFeatures
+{
+public:
+  // AVX2 instructions, with the OS saving the 256-bit registers. Checked once, false on other architectures.
+  static bool HasAvx2();
+};
@@ -0,0 +1,378 @@
+#include "DeviceAllocator.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+DeviceAllocator::DeviceAllocator()
+: physicalDevice(VK_NULL_HANDLE)
+, device(VK_NULL_HANDLE)
+, m_pAllocCB(nullptr)
+, memProperties({})
+, blockSize(0)
+, blockOrderCount(0)
+{
+}
+
+DeviceAllocator::~DeviceAllocator()
+{
+  destroy();
+}
+
+void DeviceAllocator::init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkAllocationCallbacks* a_pAllocCB,
+                           VkDeviceSize newBlockSize)
+{
+  physicalDevice = newPhysicalDevice;
+  device = newDevice;
+  m_pAllocCB = a_pAllocCB;
+
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+  // Buddy blocks must be a power of two times the smallest allocation
+  blockSize = MIN_BUDDY_SIZE;
+  blockOrderCount = 1;
+  while (blockSize < newBlockSize)
+  {
+    blockSize <<= 1;
+    ++blockOrderCount;
+  }
+}
+
+void DeviceAllocator::destroy()
+{
+  for (auto& pool : pools)
+  {
+    for (auto* block : pool.blocks)
+    {
+      if (block)
+      {
+        freeDeviceMemory(block->memory, block->size, block->mappedData != nullptr);
+        delete block;
+      }
+    }
+  }
+  pools.clear();
+}
+
+DeviceAllocation DeviceAllocator::allocate(const VkMemoryRequirements& memReqs, VkMemoryPropertyFlags properties,
+                                           bool optimalImage, AllocationStrategy strategy)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  uint32_t memoryTypeIndex = findMemoryType(memReqs.memoryTypeBits, properties);
+
+  DeviceAllocation allocation;
+  allocation.poolIndex = getPool(memoryTypeIndex, optimalImage, strategy);
+
+  // Big resources get their own memory, they would waste most of a block
+  if (memReqs.size > blockSize / 2)
+  {
+    char* mappedData = nullptr;
+    allocation.memory = allocateDeviceMemory(memoryTypeIndex, memReqs.size, &mappedData);
+    allocation.offset = 0;
+    allocation.size = memReqs.size;
+    allocation.mappedData = mappedData;
+    allocation.blockIndex = DEDICATED_BLOCK;
+  }
+  else
+  {
+    MemoryPool& pool = pools[allocation.poolIndex];
+
+    bool allocated = false;
+    for (size_t i = 0; i < pool.blocks.size() && !allocated; ++i)
+    {
+      if (pool.blocks[i] && allocateFromBlock(pool, *pool.blocks[i], memReqs, allocation))
+      {
+        allocation.blockIndex = static_cast<uint32_t>(i);
+        allocated = true;
+      }
+    }
+
+    if (!allocated)
+    {
+      // Reuse a released block slot if there is one
+      auto freeSlot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+      size_t blockIndex = freeSlot - pool.blocks.begin();
+      if (freeSlot == pool.blocks.end())
+      {
+        pool.blocks.push_back(nullptr);
+      }
+
+      pool.blocks[blockIndex] = createBlock(pool);
+      if (!allocateFromBlock(pool, *pool.blocks[blockIndex], memReqs, allocation))
+      {
+        throw std::runtime_error("Failed to sub-allocate device memory");
+      }
+      allocation.blockIndex = static_cast<uint32_t>(blockIndex);
+    }
+  }
+
+  stats.allocationCount++;
+  stats.usedBytes += allocation.size;
+  stats.peakUsedBytes = std::max(stats.peakUsedBytes, stats.usedBytes);
+
+  return allocation;
+}
+
+void DeviceAllocator::free(DeviceAllocation& allocation)
+{
+  if (allocation.memory == VK_NULL_HANDLE)
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  stats.allocationCount--;
+  stats.usedBytes -= allocation.size;
+
+  if (allocation.blockIndex == DEDICATED_BLOCK)
+  {
+    freeDeviceMemory(allocation.memory, allocation.size, allocation.mappedData != nullptr);
+  }
+  else
+  {
+    MemoryPool& pool = pools[allocation.poolIndex];
+    MemoryBlock& block = *pool.blocks[allocation.blockIndex];
+
+    if (pool.strategy == AllocationStrategy::Buddy)
+    {
+      // Merge with the buddy as long as it is free
+      VkDeviceSize offset = allocation.offset;
+      uint32_t order = 0;
+      while ((MIN_BUDDY_SIZE << order) < allocation.size)
+      {
+        ++order;
+      }
+
+      while (order + 1 < blockOrderCount)
+      {
+        VkDeviceSize buddyOffset = offset ^ (MIN_BUDDY_SIZE << order);
+        auto buddy = block.freeLists[order].find(buddyOffset);
+        if (buddy == block.freeLists[order].end())
+        {
+          break;
+        }
+
+        block.freeLists[order].erase(buddy);
+        offset = std::min(offset, buddyOffset);
+        ++order;
+      }
+      block.freeLists[order].insert(offset);
+    }
+
+    block.allocationCount--;
+    if (block.allocationCount == 0)
+    {
+      block.linearOffset = 0;
+
+      // Give empty blocks back to the driver, but keep one per pool to avoid allocating it again right away
+      size_t liveBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(), [](MemoryBlock* b) { return b != nullptr; });
+      if (liveBlocks > 1)
+      {
+        freeDeviceMemory(block.memory, block.size, block.mappedData != nullptr);
+        delete pool.blocks[allocation.blockIndex];
+        pool.blocks[allocation.blockIndex] = nullptr;
+      }
+    }
+  }
+
+  allocation = DeviceAllocation();
+}
+
+DeviceAllocation DeviceAllocator::allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, AllocationStrategy strategy)
+{
+  VkMemoryRequirements memReqs = {};
+  vkGetBufferMemoryRequirements(device, buffer, &memReqs);
+
+  DeviceAllocation allocation = allocate(memReqs, properties, false, strategy);
+
+  if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to bind buffer memory");
+  }
+
+  return allocation;
+}
+
+DeviceAllocation DeviceAllocator::allocateImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties)
+{
+  VkMemoryRequirements memReqs = {};
+  vkGetImageMemoryRequirements(device, image, &memReqs);
+
+  DeviceAllocation allocation = allocate(memReqs, properties, tiling == VK_IMAGE_TILING_OPTIMAL);
+
+  if (vkBindImageMemory(device, image, allocation.memory, allocation.offset) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to bind image memory");
+  }
+
+  return allocation;
+}
+
+void DeviceAllocator::printStats() const
+{
+  printf("Device memory: %u vkDeviceMemory live (%u allocated in total), %u sub-allocations\n",
+         stats.deviceMemoryCount, stats.totalDeviceMemoryAllocations, stats.allocationCount);
+  printf("               %.2f MB reserved (peak %.2f MB), %.2f MB used (peak %.2f MB)\n",
+         stats.reservedBytes / (1024.0 * 1024.0), stats.peakReservedBytes / (1024.0 * 1024.0),
+         stats.usedBytes / (1024.0 * 1024.0), stats.peakUsedBytes / (1024.0 * 1024.0));
+}
+
+uint32_t DeviceAllocator::findMemoryType(uint32_t allowedTypes, VkMemoryPropertyFlags properties) const
+{
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i)
+  {
+    if ((allowedTypes & (1 << i)) &&
+        (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+    {
+      return i;
+    }
+  }
+
+  throw std::runtime_error("Failed to find a suitable memory type");
+}
+
+uint32_t DeviceAllocator::getPool(uint32_t memoryTypeIndex, bool optimalImage, AllocationStrategy strategy)
+{
+  for (size_t i = 0; i < pools.size(); ++i)
+  {
+    if (pools[i].memoryTypeIndex == memoryTypeIndex &&
+        pools[i].optimalImages == optimalImage &&
+        pools[i].strategy == strategy)
+    {
+      return static_cast<uint32_t>(i);
+    }
+  }
+
+  MemoryPool pool;
+  pool.memoryTypeIndex = memoryTypeIndex;
+  pool.optimalImages = optimalImage;
+  pool.strategy = strategy;
+  pools.push_back(pool);
+
+  return static_cast<uint32_t>(pools.size() - 1);
+}
+
+VkDeviceMemory DeviceAllocator::allocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, char** mappedData)
+{
+  VkMemoryAllocateInfo memAllocInfo = {};
+  memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  memAllocInfo.allocationSize = size;
+  memAllocInfo.memoryTypeIndex = memoryTypeIndex;
+
+  VkDeviceMemory memory;
+  if (vkAllocateMemory(device, &memAllocInfo, m_pAllocCB, &memory) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to allocate device memory");
+  }
+
+  // Host visible memory stays mapped for its whole lifetime
+  *mappedData = nullptr;
+  if (memProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+  {
+    void* data;
+    if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to map device memory");
+    }
+    *mappedData = static_cast<char*>(data);
+  }
+
+  stats.deviceMemoryCount++;
+  stats.totalDeviceMemoryAllocations++;
+  stats.reservedBytes += size;
+  stats.peakReservedBytes = std::max(stats.peakReservedBytes, stats.reservedBytes);
+
+  return memory;
+}
+
+void DeviceAllocator::freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size, bool mapped)
+{
+  if (mapped)
+  {
+    vkUnmapMemory(device, memory);
+  }
+  vkFreeMemory(device, memory, m_pAllocCB);
+
+  stats.deviceMemoryCount--;
+  stats.reservedBytes -= size;
+}
+
+DeviceAllocator::MemoryBlock* DeviceAllocator::createBlock(const MemoryPool& pool)
+{
+  MemoryBlock* block = new MemoryBlock();
+  block->size = blockSize;
+  block->memory = allocateDeviceMemory(pool.memoryTypeIndex, blockSize, &block->mappedData);
+  block->allocationCount = 0;
+  block->linearOffset = 0;
+
+  if (pool.strategy == AllocationStrategy::Buddy)
+  {
+    // Whole block starts as a single free node of the highest order
+    block->freeLists.resize(blockOrderCount);
+    block->freeLists[blockOrderCount - 1].insert(0);
+  }
+
+  return block;
+}
+
+bool DeviceAllocator::allocateFromBlock(const MemoryPool& pool, MemoryBlock& block, const VkMemoryRequirements& memReqs,
+                                        DeviceAllocation& allocation)
+{
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+
+  if (pool.strategy == AllocationStrategy::Linear)
+  {
+    offset = (block.linearOffset + memReqs.alignment - 1) & ~(memReqs.alignment - 1);
+    size = memReqs.size;
+    if (offset + size > block.size)
+    {
+      return false;
+    }
+    block.linearOffset = offset + size;
+  }
+  else
+  {
+    // Buddy nodes are aligned on their size, so rounding up to the alignment is enough to respect it
+    uint32_t order = 0;
+    while ((MIN_BUDDY_SIZE << order) < memReqs.size || (MIN_BUDDY_SIZE << order) < memReqs.alignment)
+    {
+      ++order;
+    }
+    if (order >= blockOrderCount)
+    {
+      return false;
+    }
+
+    // Find the smallest free node that fits and split it down to the requested order
+    uint32_t freeOrder = order;
+    while (freeOrder < blockOrderCount && block.freeLists[freeOrder].empty())
+    {
+      ++freeOrder;
+    }
+    if (freeOrder == blockOrderCount)
+    {
+      return false;
+    }
+
+    offset = *block.freeLists[freeOrder].begin();
+    block.freeLists[freeOrder].erase(block.freeLists[freeOrder].begin());
+    while (freeOrder > order)
+    {
+      --freeOrder;
+      block.freeLists[freeOrder].insert(offset + (MIN_BUDDY_SIZE << freeOrder));
+    }
+    size = MIN_BUDDY_SIZE << order;
+  }
+
+  block.allocationCount++;
+
+  allocation.memory = block.memory;
+  allocation.offset = offset;
+  allocation.size = size;
+  allocation.mappedData = block.mappedData ? block.mappedData + offset : nullptr;
+
+  return true;
+}
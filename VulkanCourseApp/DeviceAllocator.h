@@ -0,0 +1,109 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <mutex>
+#include <set>
+#include <vector>
+
+enum class AllocationStrategy
+{
+  Buddy,      // General purpose, allocations are freed in any order
+  Linear,     // Short lived allocations (staging), a block is reused once all its allocations are freed
+};
+
+// Part of a VkDeviceMemory block handed out by the DeviceAllocator
+struct DeviceAllocation
+{
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  void* mappedData = nullptr;       // Persistently mapped pointer to offset, only for host visible memory
+  uint32_t poolIndex = 0;
+  uint32_t blockIndex = 0;
+};
+
+// Sub-allocates buffers and images from large VkDeviceMemory blocks, one set of blocks per memory type,
+// instead of calling vkAllocateMemory for each resource.
+// Buffers/linear images and optimal images never share a block, so bufferImageGranularity is always respected.
+class DeviceAllocator
+{
+public:
+  struct Stats
+  {
+    uint32_t deviceMemoryCount = 0;     // Live VkDeviceMemory (blocks and dedicated allocations)
+    uint32_t allocationCount = 0;       // Live sub-allocations
+    VkDeviceSize reservedBytes = 0;     // Device memory allocated from the driver
+    VkDeviceSize usedBytes = 0;         // Memory handed out, including alignment and rounding
+    VkDeviceSize peakReservedBytes = 0;
+    VkDeviceSize peakUsedBytes = 0;
+    uint32_t totalDeviceMemoryAllocations = 0;    // vkAllocateMemory calls since init
+  };
+
+  DeviceAllocator();
+  ~DeviceAllocator();
+
+  void init(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkAllocationCallbacks* a_pAllocCB,
+            VkDeviceSize newBlockSize = 64 * 1024 * 1024);
+  void destroy();
+
+  DeviceAllocation allocate(const VkMemoryRequirements& memReqs, VkMemoryPropertyFlags properties,
+                            bool optimalImage, AllocationStrategy strategy = AllocationStrategy::Buddy);
+  void free(DeviceAllocation& allocation);
+
+  // Allocate and bind memory to a resource
+  DeviceAllocation allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties,
+                                  AllocationStrategy strategy = AllocationStrategy::Buddy);
+  DeviceAllocation allocateImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties);
+
+  const Stats& getStats() const { return stats; }
+  void printStats() const;
+
+private:
+  static const uint32_t DEDICATED_BLOCK = ~0u;
+  static const VkDeviceSize MIN_BUDDY_SIZE = 256;
+
+  struct MemoryBlock
+  {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    char* mappedData;
+    uint32_t allocationCount;
+
+    // Linear strategy
+    VkDeviceSize linearOffset;
+
+    // Buddy strategy, free offsets for each order (order 0 is MIN_BUDDY_SIZE bytes)
+    std::vector<std::set<VkDeviceSize>> freeLists;
+  };
+
+  struct MemoryPool
+  {
+    uint32_t memoryTypeIndex;
+    bool optimalImages;
+    AllocationStrategy strategy;
+    std::vector<MemoryBlock*> blocks;     // Released blocks are left null to keep block indices valid
+  };
+
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  VkAllocationCallbacks* m_pAllocCB;
+  VkPhysicalDeviceMemoryProperties memProperties;
+  VkDeviceSize blockSize;
+  uint32_t blockOrderCount;
+
+  std::vector<MemoryPool> pools;
+  Stats stats;
+  std::mutex mutex;
+
+  uint32_t findMemoryType(uint32_t allowedTypes, VkMemoryPropertyFlags properties) const;
+  uint32_t getPool(uint32_t memoryTypeIndex, bool optimalImage, AllocationStrategy strategy);
+
+  VkDeviceMemory allocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, char** mappedData);
+  void freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size, bool mapped);
+
+  MemoryBlock* createBlock(const MemoryPool& pool);
+  bool allocateFromBlock(const MemoryPool& pool, MemoryBlock& block, const VkMemoryRequirements& memReqs,
+                         DeviceAllocation& allocation);
+};
@@ -0,0 +1,99 @@
+#include "FrameRingBuffer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+FrameRingBuffer::FrameRingBuffer()
+: device(VK_NULL_HANDLE)
+, allocator(nullptr)
+, m_pAllocCB(nullptr)
+, buffer(VK_NULL_HANDLE)
+, usage(0)
+, alignment(1)
+, frameSize(0)
+, frameCount(0)
+, frameBegin(0)
+, frameOffset(0)
+{
+}
+
+FrameRingBuffer::~FrameRingBuffer()
+{
+}
+
+void FrameRingBuffer::init(VkDevice newDevice,
+                           DeviceAllocator& newAllocator,
+                           VkBufferUsageFlags newUsage,
+                           VkDeviceSize newAlignment,
+                           VkDeviceSize newFrameSize,
+                           uint32_t newFrameCount,
+                           VkAllocationCallbacks* a_pAllocCB)
+{
+  device = newDevice;
+  allocator = &newAllocator;
+  m_pAllocCB = a_pAllocCB;
+  usage = newUsage;
+  alignment = std::max<VkDeviceSize>(newAlignment, 1);
+  frameSize = alignSize(newFrameSize);
+  frameCount = newFrameCount;
+
+  createBuffer();
+}
+
+void FrameRingBuffer::destroy()
+{
+  destroyBuffer();
+}
+
+void FrameRingBuffer::resize(VkDeviceSize newFrameSize)
+{
+  destroyBuffer();
+  frameSize = alignSize(newFrameSize);
+  createBuffer();
+}
+
+void FrameRingBuffer::beginFrame(uint32_t frameIndex)
+{
+  frameBegin = frameSize * frameIndex;
+  frameOffset = 0;
+}
+
+VkDeviceSize FrameRingBuffer::allocate(VkDeviceSize size, void** mappedData)
+{
+  if (frameOffset + size > frameSize)
+  {
+    throw std::runtime_error("Frame ring buffer partition is full");
+  }
+
+  VkDeviceSize offset = frameBegin + frameOffset;
+  frameOffset += alignSize(size);
+
+  *mappedData = static_cast<char*>(bufferMemory.mappedData) + offset;
+  return offset;
+}
+
+void FrameRingBuffer::createBuffer()
+{
+  // Host coherent, writes are visible to the device at submit without flushing
+  ::createBuffer(device,
+                 *allocator,
+                 frameSize * frameCount,
+                 usage,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 &buffer,
+                 &bufferMemory,
+                 m_pAllocCB);
+
+  frameBegin = 0;
+  frameOffset = 0;
+}
+
+void FrameRingBuffer::destroyBuffer()
+{
+  if (buffer != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(device, buffer, m_pAllocCB);
+    allocator->free(bufferMemory);
+    buffer = VK_NULL_HANDLE;
+  }
+}
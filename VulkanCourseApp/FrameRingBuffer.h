@@ -0,0 +1,60 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "Utilities.h"
+
+// One persistently mapped buffer split in a partition per frame in flight.
+// Per-frame constants are sub-allocated from the partition of the current frame and bound with dynamic offsets,
+// so nothing is mapped, unmapped or reallocated while drawing.
+class FrameRingBuffer
+{
+public:
+  FrameRingBuffer();
+  ~FrameRingBuffer();
+
+  void init(VkDevice newDevice,
+            DeviceAllocator& newAllocator,
+            VkBufferUsageFlags newUsage,
+            VkDeviceSize newAlignment,
+            VkDeviceSize newFrameSize,
+            uint32_t newFrameCount,
+            VkAllocationCallbacks* a_pAllocCB = nullptr);
+  void destroy();
+
+  // Recreate the buffer with bigger partitions, the device must not be using it anymore
+  void resize(VkDeviceSize newFrameSize);
+
+  // Start allocating from the partition of frameIndex, the device must be done with its previous contents
+  void beginFrame(uint32_t frameIndex);
+
+  // Aligned sub-allocation in the current partition, returns its offset from the start of the buffer
+  VkDeviceSize allocate(VkDeviceSize size, void** mappedData);
+
+  VkDeviceSize alignSize(VkDeviceSize size) const { return (size + alignment - 1) & ~(alignment - 1); }
+
+  // Mapped address of an earlier allocation, to read back what the device wrote there
+  void* getMappedData(VkDeviceSize offset) const { return static_cast<char*>(bufferMemory.mappedData) + offset; }
+
+  VkBuffer getBuffer() const { return buffer; }
+  VkDeviceSize getFrameSize() const { return frameSize; }
+
+private:
+  VkDevice device;
+  DeviceAllocator* allocator;
+  VkAllocationCallbacks* m_pAllocCB;
+
+  VkBuffer buffer;
+  DeviceAllocation bufferMemory;
+  VkBufferUsageFlags usage;
+  VkDeviceSize alignment;
+  VkDeviceSize frameSize;
+  uint32_t frameCount;
+
+  VkDeviceSize frameBegin;
+  VkDeviceSize frameOffset;
+
+  void createBuffer();
+  void destroyBuffer();
+};
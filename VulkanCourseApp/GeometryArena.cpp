@@ -0,0 +1,258 @@
+#include "GeometryArena.h"
+#include "UploadBatch.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+GeometryArena::GeometryArena()
+: device(VK_NULL_HANDLE)
+, allocator(nullptr)
+, m_pAllocCB(nullptr)
+, vertexSize(0)
+, vertexBuffer(VK_NULL_HANDLE)
+, meshletBuffer(VK_NULL_HANDLE)
+{
+}
+
+GeometryArena::~GeometryArena()
+{
+}
+
+void GeometryArena::init(VkDevice newDevice,
+                         DeviceAllocator& newAllocator,
+                         uint32_t newVertexSize,
+                         uint32_t newVertexCapacity,
+                         uint32_t newIndexCapacity,
+                         uint32_t newMeshletCapacity,
+                         VkAllocationCallbacks* a_pAllocCB)
+{
+  device = newDevice;
+  allocator = &newAllocator;
+  m_pAllocCB = a_pAllocCB;
+  vertexSize = newVertexSize;
+
+  createBuffer(static_cast<VkDeviceSize>(vertexSize) * newVertexCapacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer, &vertexBufferMemory);
+  vertexRanges.reset(newVertexCapacity);
+
+  const VkIndexType indexTypes[] = { VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32 };
+  for (VkIndexType indexType : indexTypes)
+  {
+    uint32_t indexCapacity = indexType == VK_INDEX_TYPE_UINT16 ? newIndexCapacity : std::max(newIndexCapacity / 4, 1u);
+    IndexPool& pool = getIndexPool(indexType);
+    createBuffer(static_cast<VkDeviceSize>(IndexSize(indexType)) * indexCapacity, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                 &pool.buffer, &pool.memory);
+    pool.ranges.reset(indexCapacity);
+  }
+
+  createBuffer(sizeof(Meshlet) * newMeshletCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &meshletBuffer, &meshletBufferMemory);
+  meshletRanges.reset(newMeshletCapacity);
+}
+
+void GeometryArena::destroy()
+{
+  if (vertexBuffer != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(device, vertexBuffer, m_pAllocCB);
+    allocator->free(vertexBufferMemory);
+    vertexBuffer = VK_NULL_HANDLE;
+  }
+
+  for (IndexPool& pool : indexPools)
+  {
+    if (pool.buffer != VK_NULL_HANDLE)
+    {
+      vkDestroyBuffer(device, pool.buffer, m_pAllocCB);
+      allocator->free(pool.memory);
+      pool.buffer = VK_NULL_HANDLE;
+    }
+  }
+
+  if (meshletBuffer != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(device, meshletBuffer, m_pAllocCB);
+    allocator->free(meshletBufferMemory);
+    meshletBuffer = VK_NULL_HANDLE;
+  }
+}
+
+GeometryRange GeometryArena::allocate(UploadBatch& uploadBatch,
+                                      const void* vertices,
+                                      uint32_t vertexCount,
+                                      const void* indices,
+                                      uint32_t indexCount,
+                                      VkIndexType indexType,
+                                      const Meshlet* meshlets,
+                                      uint32_t meshletCount)
+{
+  GeometryRange range;
+  range.vertexCount = vertexCount;
+  range.indexCount = indexCount;
+  range.indexType = indexType;
+  range.meshletCount = meshletCount;
+
+  if (vertexCount > 0)
+  {
+    while (!vertexRanges.allocate(vertexCount, range.vertexOffset))
+    {
+      uint32_t oldCapacity = vertexRanges.getCapacity();
+      uint32_t newCapacity = std::max(oldCapacity * 2, oldCapacity + vertexCount);
+      growBuffer(uploadBatch, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, static_cast<VkDeviceSize>(vertexSize) * oldCapacity,
+                 static_cast<VkDeviceSize>(vertexSize) * newCapacity, vertexBuffer, vertexBufferMemory);
+      vertexRanges.grow(newCapacity);
+    }
+
+    uploadBatch.uploadBuffer(vertexBuffer, vertices, static_cast<VkDeviceSize>(vertexSize) * vertexCount,
+                             static_cast<VkDeviceSize>(vertexSize) * range.vertexOffset);
+  }
+
+  if (indexCount > 0)
+  {
+    IndexPool& pool = getIndexPool(indexType);
+    VkDeviceSize indexSize = IndexSize(indexType);
+    while (!pool.ranges.allocate(indexCount, range.firstIndex))
+    {
+      uint32_t oldCapacity = pool.ranges.getCapacity();
+      uint32_t newCapacity = std::max(oldCapacity * 2, oldCapacity + indexCount);
+      growBuffer(uploadBatch, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indexSize * oldCapacity, indexSize * newCapacity,
+                 pool.buffer, pool.memory);
+      pool.ranges.grow(newCapacity);
+    }
+
+    uploadBatch.uploadBuffer(pool.buffer, indices, indexSize * indexCount, indexSize * range.firstIndex);
+  }
+
+  if (meshletCount > 0)
+  {
+    while (!meshletRanges.allocate(meshletCount, range.firstMeshlet))
+    {
+      uint32_t oldCapacity = meshletRanges.getCapacity();
+      uint32_t newCapacity = std::max(oldCapacity * 2, oldCapacity + meshletCount);
+      growBuffer(uploadBatch, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(Meshlet) * oldCapacity, sizeof(Meshlet) * newCapacity,
+                 meshletBuffer, meshletBufferMemory);
+      meshletRanges.grow(newCapacity);
+    }
+
+    uploadMeshlets.assign(meshlets, meshlets + meshletCount);
+    for (auto& meshlet : uploadMeshlets)
+    {
+      meshlet.firstIndex += range.firstIndex;
+    }
+    uploadBatch.uploadBuffer(meshletBuffer, uploadMeshlets.data(), sizeof(Meshlet) * meshletCount,
+                             sizeof(Meshlet) * range.firstMeshlet);
+  }
+
+  return range;
+}
+
+void GeometryArena::free(const GeometryRange& range)
+{
+  if (range.vertexCount > 0)
+  {
+    vertexRanges.free(range.vertexOffset, range.vertexCount);
+  }
+  if (range.indexCount > 0)
+  {
+    getIndexPool(range.indexType).ranges.free(range.firstIndex, range.indexCount);
+  }
+  if (range.meshletCount > 0)
+  {
+    meshletRanges.free(range.firstMeshlet, range.meshletCount);
+  }
+}
+
+void GeometryArena::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer* buffer, DeviceAllocation* bufferMemory)
+{
+  // Transfer source too, to copy the content when growing
+  ::createBuffer(device,
+                 *allocator,
+                 size,
+                 usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 buffer,
+                 bufferMemory,
+                 m_pAllocCB);
+}
+
+void GeometryArena::growBuffer(UploadBatch& uploadBatch, VkBufferUsageFlags usage, VkDeviceSize oldSize, VkDeviceSize newSize,
+                               VkBuffer& buffer, DeviceAllocation& bufferMemory)
+{
+  // Uploads already recorded target the old buffer, and frames in flight may still read it
+  uploadBatch.submit();
+  vkDeviceWaitIdle(device);
+
+  VkBuffer newBuffer;
+  DeviceAllocation newBufferMemory;
+  createBuffer(newSize, usage, &newBuffer, &newBufferMemory);
+
+  uploadBatch.copyBuffer(buffer, newBuffer, oldSize);
+  uploadBatch.submit();
+
+  vkDestroyBuffer(device, buffer, m_pAllocCB);
+  allocator->free(bufferMemory);
+
+  buffer = newBuffer;
+  bufferMemory = newBufferMemory;
+}
+
+void GeometryArena::FreeList::reset(uint32_t newCapacity)
+{
+  freeRanges.clear();
+  capacity = newCapacity;
+  if (capacity > 0)
+  {
+    freeRanges[0] = capacity;
+  }
+}
+
+void GeometryArena::FreeList::grow(uint32_t newCapacity)
+{
+  uint32_t oldCapacity = capacity;
+  capacity = newCapacity;
+  free(oldCapacity, newCapacity - oldCapacity);
+}
+
+bool GeometryArena::FreeList::allocate(uint32_t count, uint32_t& offset)
+{
+  for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+  {
+    if (it->second >= count)
+    {
+      offset = it->first;
+      uint32_t remaining = it->second - count;
+      freeRanges.erase(it);
+      if (remaining > 0)
+      {
+        freeRanges[offset + count] = remaining;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+void GeometryArena::FreeList::free(uint32_t offset, uint32_t count)
+{
+  auto next = freeRanges.lower_bound(offset);
+
+  // Merge with the previous free range
+  if (next != freeRanges.begin())
+  {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset)
+    {
+      offset = prev->first;
+      count += prev->second;
+      freeRanges.erase(prev);
+    }
+  }
+
+  // Merge with the next free range
+  if (next != freeRanges.end() && offset + count == next->first)
+  {
+    count += next->second;
+    freeRanges.erase(next);
+  }
+
+  freeRanges[offset] = count;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <map>
+#include <vector>
+
+#include "Utilities.h"
+
+class UploadBatch;
+
+// Part of the arena buffers used by one mesh, offsets are in vertices, indices and meshlets
+struct GeometryRange
+{
+  uint32_t vertexOffset = 0;
+  uint32_t vertexCount = 0;
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+  VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+  uint32_t firstMeshlet = 0;
+  uint32_t meshletCount = 0;
+};
+
+// One device local vertex buffer and one index buffer per index type shared by every mesh, and a storage buffer
+// with the meshlets read by the cluster culling pass.
+// Meshes get a range of each, so the geometry is bound once and draws only differ by their offsets.
+class GeometryArena
+{
+public:
+  GeometryArena();
+  ~GeometryArena();
+
+  // Vertices are opaque to the arena, only their size matters.
+  // Index capacity is for 16-bit indices, few meshes need 32-bit ones and their buffer starts smaller.
+  void init(VkDevice newDevice,
+            DeviceAllocator& newAllocator,
+            uint32_t newVertexSize,
+            uint32_t newVertexCapacity,
+            uint32_t newIndexCapacity,
+            uint32_t newMeshletCapacity,
+            VkAllocationCallbacks* a_pAllocCB = nullptr);
+  void destroy();
+
+  // Reserve a range and record the upload of its data in the batch.
+  // When the arena is full it grows: the batch is submitted, the device waits idle and the content is copied over.
+  // First indices of the meshlets are relative to the indices, they are uploaded relative to the index buffer.
+  GeometryRange allocate(UploadBatch& uploadBatch,
+                         const void* vertices,
+                         uint32_t vertexCount,
+                         const void* indices,
+                         uint32_t indexCount,
+                         VkIndexType indexType,
+                         const Meshlet* meshlets,
+                         uint32_t meshletCount);
+  void free(const GeometryRange& range);
+
+  VkBuffer getVertexBuffer() const { return vertexBuffer; }
+  VkBuffer getIndexBuffer(VkIndexType indexType) const { return getIndexPool(indexType).buffer; }
+  // Replaced when the arena grows
+  VkBuffer getMeshletBuffer() const { return meshletBuffer; }
+
+  // Smallest index type able to address every vertex of a mesh
+  static VkIndexType IndexTypeFor(uint32_t vertexCount) { return vertexCount <= 0xFFFF ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32; }
+  static uint32_t IndexSize(VkIndexType indexType) { return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t); }
+
+private:
+  // First fit free list, free ranges are merged with their neighbours
+  class FreeList
+  {
+  public:
+    void reset(uint32_t newCapacity);
+    void grow(uint32_t newCapacity);
+    bool allocate(uint32_t count, uint32_t& offset);
+    void free(uint32_t offset, uint32_t count);
+
+    uint32_t getCapacity() const { return capacity; }
+
+  private:
+    std::map<uint32_t, uint32_t> freeRanges;    // Offset to count
+    uint32_t capacity = 0;
+  };
+
+  VkDevice device;
+  DeviceAllocator* allocator;
+  VkAllocationCallbacks* m_pAllocCB;
+
+  uint32_t vertexSize;
+  VkBuffer vertexBuffer;
+  DeviceAllocation vertexBufferMemory;
+  FreeList vertexRanges;
+
+  struct IndexPool
+  {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    DeviceAllocation memory;
+    FreeList ranges;
+  };
+  IndexPool indexPools[2];    // 16-bit and 32-bit indices
+  IndexPool& getIndexPool(VkIndexType indexType) { return indexPools[indexType == VK_INDEX_TYPE_UINT16 ? 0 : 1]; }
+  const IndexPool& getIndexPool(VkIndexType indexType) const { return indexPools[indexType == VK_INDEX_TYPE_UINT16 ? 0 : 1]; }
+
+  VkBuffer meshletBuffer;
+  DeviceAllocation meshletBufferMemory;
+  FreeList meshletRanges;
+  std::vector<Meshlet> uploadMeshlets;
+
+  void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer* buffer, DeviceAllocation* bufferMemory);
+  void growBuffer(UploadBatch& uploadBatch, VkBufferUsageFlags usage, VkDeviceSize oldSize, VkDeviceSize newSize,
+                  VkBuffer& buffer, DeviceAllocation& bufferMemory);
+};
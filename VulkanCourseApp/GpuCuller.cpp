@@ -0,0 +1,49 @@
+#include "GpuCuller.h"
+
+#include <array>
+#include <cstring>
+
+GpuCuller::GpuCuller()
+{
+}
+
+GpuCuller::~GpuCuller()
+{
+}
+
+void GpuCuller::init(VkDevice newDevice, const std::string& shaderFile, VkAllocationCallbacks* a_pAllocCB)
+{
+  // Objects, cull draws, commands, counts and instance indices
+  pass.init(newDevice, shaderFile, 5, 0, sizeof(CullParams), a_pAllocCB);
+}
+
+void GpuCuller::destroy()
+{
+  pass.destroy();
+}
+
+void GpuCuller::setBuffer(VkBuffer buffer)
+{
+  pass.setDynamicBuffer(buffer);
+}
+
+void GpuCuller::record(VkCommandBuffer commandBuffer,
+                       const glm::vec4 planes[6],
+                       uint32_t drawCount,
+                       uint32_t objectsOffset,
+                       uint32_t drawsOffset,
+                       uint32_t commandsOffset,
+                       uint32_t countsOffset,
+                       uint32_t instanceIndicesOffset)
+{
+  CullParams params;
+  memcpy(params.planes, planes, sizeof(params.planes));
+  params.drawCount = drawCount;
+
+  std::array<uint32_t, 5> dynamicOffsets = { objectsOffset, drawsOffset, commandsOffset, countsOffset, instanceIndicesOffset };
+
+  pass.bind(commandBuffer, dynamicOffsets.data(), &params);
+  vkCmdDispatch(commandBuffer, (drawCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+  ComputePass::RecordOutputBarrier(commandBuffer);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <string>
+
+#include "ComputePass.h"
+#include "Utilities.h"
+
+// Compute pass testing the bounding sphere of every instance against the view frustum before the render pass,
+// and appending the visible ones to the instances of their batch's indirect draw command.
+// Its inputs and outputs are sub-allocations of a single buffer, selected with dynamic offsets.
+class GpuCuller
+{
+public:
+  // Per instance input of the culling pass, std430 layout
+  struct CullDraw
+  {
+    glm::vec4 sphere;               // Model space center and radius
+    uint32_t objectIndex;           // Index of the object data
+    uint32_t batchIndex;            // Command drawing the instances of its mesh
+    uint32_t batchFirstInstance;    // First instance index slot of the batch
+    uint32_t padding;
+  };
+
+  GpuCuller();
+  ~GpuCuller();
+
+  // Throws if the shader can't be read or the pipeline can't be created
+  void init(VkDevice newDevice, const std::string& shaderFile, VkAllocationCallbacks* a_pAllocCB = nullptr);
+  void destroy();
+
+  // Buffer holding the culling data, must be set again when it is recreated
+  void setBuffer(VkBuffer buffer);
+
+  // Record the dispatch and the barrier making its output visible to indirect draws and to the host.
+  // Commands must be written with no instance and counts[0] zeroed before submitting: every visible instance
+  // increments the instance count of its batch's command, writes its object index in the batch's slots,
+  // and increments counts[0].
+  void record(VkCommandBuffer commandBuffer,
+              const glm::vec4 planes[6],
+              uint32_t drawCount,
+              uint32_t objectsOffset,
+              uint32_t drawsOffset,
+              uint32_t commandsOffset,
+              uint32_t countsOffset,
+              uint32_t instanceIndicesOffset);
+
+private:
+  struct CullParams
+  {
+    glm::vec4 planes[6];
+    uint32_t drawCount;
+  };
+
+  static const uint32_t GROUP_SIZE = 64;      // Must match local_size_x in the shader
+
+  ComputePass pass;
+};
@@ -1,28 +1,45 @@
 #include "Mesh.h"
 
-Mesh::Mesh(VkPhysicalDevice newPhysicalDevice,
-           VkDevice newDevice,
-           VkQueue transferQueue,
-           VkCommandPool transferCmdPool,
-           const std::vector<Vertex>& vertices,
-           const std::vector<uint32_t>& indices,
-           int newTexId,
-           VkAllocationCallbacks* a_pAllocCB)
-: vertexCount(vertices.size())
-, physicalDevice(newPhysicalDevice)
-, device(newDevice)
-, indexCount(indices.size())
+static uint32_t nextMeshId = 0;
+
+Mesh::Mesh(GeometryArena& newArena,
+           UploadBatch& uploadBatch,
+           const void* vertices,
+           size_t newVertexCount,
+           const void* indices,
+           size_t newIndexCount,
+           VkIndexType indexType,
+           const MeshLod* newLods,
+           uint32_t lodCount,
+           const Meshlet* meshlets,
+           uint32_t meshletCount,
+           const BoundingSphere& newBounds,
+           const glm::vec3& newPositionScale,
+           const glm::vec3& newPositionBias,
+           int newTexId)
+: id(nextMeshId++)
 , texId(newTexId)
+, bounds(newBounds)
+, positionScale(newPositionScale)
+, positionBias(newPositionBias)
+, arena(&newArena)
 {
   model.model = glm::mat4(1.0f);
 
-  if (vertices.size() != 0)
+  // Data goes through the batch staging buffer, the copy to the GPU happens when the batch is submitted
+  geometry = arena->allocate(uploadBatch,
+                             vertices,
+                             static_cast<uint32_t>(newVertexCount),
+                             indices,
+                             static_cast<uint32_t>(newIndexCount),
+                             indexType,
+                             meshlets,
+                             meshletCount);
+
+  lods.assign(newLods, newLods + lodCount);
+  for (auto& lod : lods)
   {
-    initBuffer(vertexBuffer, vertexBufferMemory, vertices.data(), sizeof(vertices[0]) * vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, transferQueue, transferCmdPool);
-  }
-  if (indices.size() != 0)
-  {
-    initBuffer(indexBuffer, indexBufferMemory, indices.data(), sizeof(indices[0]) * indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, transferQueue, transferCmdPool);
+    lod.firstIndex += geometry.firstIndex;
   }
 }
 
@@ -33,63 +50,6 @@ Mesh::~Mesh()
 
 void Mesh::destroyBuffers()
 {
-  if (vertexBuffer != VK_NULL_HANDLE)
-  {
-    vkDestroyBuffer(device, vertexBuffer, m_pAllocCB);
-    vkFreeMemory(device, vertexBufferMemory, m_pAllocCB);
-    vertexBuffer = VK_NULL_HANDLE;
-    vertexCount = 0;
-  }
-
-  if (indexBuffer != VK_NULL_HANDLE)
-  {
-    vkDestroyBuffer(device, indexBuffer, m_pAllocCB);
-    vkFreeMemory(device, indexBufferMemory, m_pAllocCB);
-    indexBuffer = VK_NULL_HANDLE;
-    indexCount = 0;
-  }
-}
-
-void Mesh::initBuffer(VkBuffer& buffer,
-                      VkDeviceMemory& deviceMemory,
-                      const void* srcData,
-                      VkDeviceSize bufferSize,
-                      VkBufferUsageFlagBits bufferUsage,
-                      VkQueue transferQueue,
-                      VkCommandPool transferCmdPool)
-{
-  // Temporary buffer to stage vertex data before transferring to GPU
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  createBuffer(physicalDevice,
-               device,
-               bufferSize,
-               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-               &stagingBuffer,
-               &stagingBufferMemory,
-               m_pAllocCB);
-
-  // Map vertex data to vertex buffer
-  void* dstData;
-  vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &dstData);
-  memcpy(dstData, srcData, static_cast<size_t>(bufferSize));
-  vkUnmapMemory(device, stagingBufferMemory);
-
-  // Buffer only visible on GPU that would receive the data from the CPU visible buffer
-  createBuffer(physicalDevice,
-               device,
-               bufferSize,
-               bufferUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-               &buffer,
-               &deviceMemory,
-               m_pAllocCB);
-
-  // Copy the buffer to the GPU
-  copyBuffer(device, transferQueue, transferCmdPool, stagingBuffer, buffer, bufferSize);
-
-  // Delete the staging buffer
-  vkDestroyBuffer(device, stagingBuffer, m_pAllocCB);
-  vkFreeMemory(device, stagingBufferMemory, m_pAllocCB);
+  arena->free(geometry);
+  geometry = GeometryRange();
 }
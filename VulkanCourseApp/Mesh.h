@@ -3,6 +3,8 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include "GeometryArena.h"
+#include "UploadBatch.h"
 #include "Utilities.h"
 
 #include <vector>
@@ -15,14 +17,21 @@ struct Model
 class Mesh
 {
 public:
-  Mesh(VkPhysicalDevice newPhysicalDevice,
-       VkDevice newDevice,
-       VkQueue transferQueue,
-       VkCommandPool transferCmdPool,
-       const std::vector<Vertex>& vertices,
-       const std::vector<uint32_t>& indices,
-       int newTexId,
-       VkAllocationCallbacks* a_pAllocCB = nullptr);
+  Mesh(GeometryArena& newArena,
+       UploadBatch& uploadBatch,
+       const void* vertices,
+       size_t newVertexCount,
+       const void* indices,
+       size_t newIndexCount,
+       VkIndexType indexType,
+       const MeshLod* newLods,
+       uint32_t lodCount,
+       const Meshlet* meshlets,
+       uint32_t meshletCount,
+       const BoundingSphere& newBounds,
+       const glm::vec3& newPositionScale,
+       const glm::vec3& newPositionBias,
+       int newTexId);
   ~Mesh();
 
   void setModel(const glm::mat4& newModel) { model.model = newModel; }
@@ -30,40 +39,47 @@ public:
 
   int getTexId() const { return texId; }
 
-  void destroyBuffers();
+  // Unique per mesh, used in sort keys so the instances of a mesh end up next to each other
+  uint32_t getId() const { return id; }
 
-  int getVertexCount() const { return vertexCount; }
-  VkBuffer getVertexBuffer() const { return vertexBuffer; }
+  const BoundingSphere& getBounds() const { return bounds; }
 
-  int getIndexCount() const { return indexCount; }
-  VkBuffer getIndexBuffer() const { return indexBuffer; }
+  // Model space position is position * scale + bias, only packed vertices aren't already in model space
+  const glm::vec3& getPositionScale() const { return positionScale; }
+  const glm::vec3& getPositionBias() const { return positionBias; }
 
-private:
-  Model model;
+  void destroyBuffers();
 
-  int texId;
+  // Geometry lives in the shared arena buffers, offsets are in vertices and indices
+  int getVertexCount() const { return geometry.vertexCount; }
+  int getVertexOffset() const { return geometry.vertexOffset; }
 
-  int vertexCount;
-  VkBuffer vertexBuffer;
-  VkDeviceMemory vertexBufferMemory;
+  // Full detail indices
+  int getIndexCount() const { return lods[0].indexCount; }
+  uint32_t getFirstIndex() const { return lods[0].firstIndex; }
 
-  int indexCount;
-  VkBuffer indexBuffer;
-  VkDeviceMemory indexBufferMemory;
+  // LOD 0 is the full detail mesh, the next ones have fewer triangles and a larger error.
+  // Their first index is in the arena index buffer, like the full detail one.
+  uint32_t getLodCount() const { return static_cast<uint32_t>(lods.size()); }
+  const MeshLod& getLod(uint32_t lod) const { return lods[lod]; }
 
-  VkQueue transferQueue;
-  VkCommandPool transferCmdPool;
+  // Meshlets of the full detail LOD, in the arena meshlet buffer
+  uint32_t getFirstMeshlet() const { return geometry.firstMeshlet; }
+  uint32_t getMeshletCount() const { return geometry.meshletCount; }
 
-  VkPhysicalDevice physicalDevice;
-  VkDevice device;
-  VkAllocationCallbacks* m_pAllocCB;
+  // Selects the arena index buffer to bind, 16-bit when the mesh has fewer than 65536 vertices
+  VkIndexType getIndexType() const { return geometry.indexType; }
 
-  void initBuffer(VkBuffer& buffer,
-                  VkDeviceMemory& deviceMemory,
-                  const void* srcData,
-                  VkDeviceSize bufferSize,
-                  VkBufferUsageFlagBits bufferUsage,
-                  VkQueue transferQueue,
-                  VkCommandPool transferCmdPool);
-};
+private:
+  Model model;
 
+  uint32_t id;
+  int texId;
+  BoundingSphere bounds;
+  glm::vec3 positionScale;
+  glm::vec3 positionBias;
+
+  GeometryArena* arena;
+  GeometryRange geometry;
+  std::vector<MeshLod> lods;
+};
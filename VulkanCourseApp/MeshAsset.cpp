@@ -0,0 +1,46 @@
+#include "Mesh.h"
+#include "MeshAsset.h"
+
+MeshAsset::MeshAsset(const std::vector<Mesh*>& newMeshList, const std::vector<int>& newTextureIds,
+                     const std::vector<MeshNode>& newNodes, const std::vector<uint32_t>& newNodeMeshes,
+                     const std::function<void(int)>& newReleaseTexture)
+: nodes(newNodes)
+, nodeMeshes(newNodeMeshes)
+, releaseTexture(newReleaseTexture)
+{
+  // Slot 0 is the default texture, not taken from the cache
+  for (int texId : newTextureIds)
+  {
+    if (texId != 0)
+    {
+      textureIds.push_back(texId);
+    }
+  }
+
+  meshList.reserve(newMeshList.size());
+
+  for (auto& mesh : newMeshList)
+  {
+    if (mesh)
+    {
+      meshList.push_back(mesh);
+    }
+  }
+}
+
+MeshAsset::~MeshAsset()
+{
+  // Mesh destructor gives its range back to the geometry arena
+  for (auto& mesh : meshList)
+  {
+    delete mesh;
+  }
+  meshList.clear();
+
+  // Textures go away with the last asset using them
+  for (int texId : textureIds)
+  {
+    releaseTexture(texId);
+  }
+  textureIds.clear();
+}
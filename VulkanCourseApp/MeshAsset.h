@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cassert>
+#include <functional>
+#include <vector>
+
+#include "Utilities.h"
+
+class Mesh;
+
+// Meshes imported from one model file, shared by every MeshModel created from that file.
+// Their geometry is uploaded once, and released when the last model using them is destroyed.
+class MeshAsset
+{
+public:
+  // Each texture id is given back to releaseTexture when the asset is destroyed
+  MeshAsset(const std::vector<Mesh*>& newMeshList, const std::vector<int>& newTextureIds,
+            const std::vector<MeshNode>& newNodes, const std::vector<uint32_t>& newNodeMeshes,
+            const std::function<void(int)>& newReleaseTexture);
+  ~MeshAsset();
+
+  size_t getMeshCount() const { return meshList.size(); }
+  Mesh* getMesh(size_t index) const { assert(index < meshList.size()); return meshList[index]; }
+
+  // Transform hierarchy of the file, parents first. Each node draws the meshes of its range of node meshes.
+  size_t getNodeCount() const { return nodes.size(); }
+  const MeshNode& getNode(size_t index) const { assert(index < nodes.size()); return nodes[index]; }
+  uint32_t getNodeMesh(uint32_t index) const { assert(index < nodeMeshes.size()); return nodeMeshes[index]; }
+
+  // Meshes drawn by all the nodes, a mesh used by several nodes counts once for each
+  size_t getDrawCount() const { return nodeMeshes.size(); }
+
+  // Texture slots of the materials, one reference in the texture cache each
+  const std::vector<int>& getTextureIds() const { return textureIds; }
+
+private:
+  std::vector<Mesh*> meshList;
+  std::vector<int> textureIds;
+  std::vector<MeshNode> nodes;
+  std::vector<uint32_t> nodeMeshes;
+  std::function<void(int)> releaseTexture;
+};
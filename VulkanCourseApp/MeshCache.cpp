@@ -0,0 +1,357 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+
+static uint64_t alignOffset(uint64_t offset)
+{
+  return (offset + 15) & ~uint64_t(15);
+}
+
+// Materials of OBJ files are in a separate file, changing them must also invalidate the cache
+static std::string getMaterialFile(const std::string& modelFile)
+{
+  size_t extIdx = modelFile.rfind('.');
+  return extIdx != std::string::npos ? modelFile.substr(0, extIdx) + ".mtl" : std::string();
+}
+
+MeshCache::MeshCache()
+: meshCount(0)
+, meshRanges(nullptr)
+, vertexData(nullptr)
+, indexData(nullptr)
+, meshletData(nullptr)
+, nodeCount(0)
+, nodeData(nullptr)
+, nodeMeshCount(0)
+, nodeMeshData(nullptr)
+{
+}
+
+uint64_t MeshCache::HashModelFiles(const std::string& modelFile)
+{
+  uint64_t hash = FNV_OFFSET_BASIS;
+
+  std::vector<char> modelData = readFile(modelFile);
+  hash = hashBytes(modelData.data(), modelData.size(), hash);
+
+  std::ifstream materialFile(getMaterialFile(modelFile), std::ios::binary);
+  if (materialFile.is_open())
+  {
+    std::vector<char> materialData((std::istreambuf_iterator<char>(materialFile)), std::istreambuf_iterator<char>());
+    hash = hashBytes(materialData.data(), materialData.size(), hash);
+  }
+
+  return hash;
+}
+
+uint64_t MeshCache::StampModelFiles(const std::string& modelFile)
+{
+  uint64_t hash = FNV_OFFSET_BASIS;
+
+  // A missing file stamps as size and time 0, it can't be mistaken for an existing one
+  for (const std::string& file : { modelFile, getMaterialFile(modelFile) })
+  {
+    std::error_code error;
+    uint64_t size = file.empty() ? 0 : std::filesystem::file_size(file, error);
+    int64_t time = file.empty() || error ? 0 : std::filesystem::last_write_time(file, error).time_since_epoch().count();
+    if (error)
+    {
+      size = 0;
+      time = 0;
+    }
+    hash = hashBytes(&size, sizeof(size), hash);
+    hash = hashBytes(&time, sizeof(time), hash);
+  }
+
+  return hash;
+}
+
+bool MeshCache::load(const std::string& cacheFile, const std::string& modelFile, uint32_t importFlags)
+{
+  std::ifstream file(cacheFile, std::ios::binary | std::ios::ate);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  size_t fileSize = (size_t)file.tellg();
+  if (fileSize < sizeof(Header))
+  {
+    return false;
+  }
+
+  // Check the header before reading the rest of the file
+  Header header;
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(&header), sizeof(Header));
+
+  if (header.magic != MAGIC ||
+      header.version != VERSION ||
+      header.importFlags != importFlags ||
+      header.fileSize != fileSize ||
+      header.textureNamesOffset + header.textureNamesSize > fileSize ||
+      header.meshRangesOffset + sizeof(MeshRange) * header.meshCount > fileSize ||
+      header.verticesOffset + sizeof(Vertex) * header.vertexCount > fileSize ||
+      header.indicesOffset + sizeof(uint32_t) * header.indexCount > fileSize ||
+      header.meshletsOffset + sizeof(Meshlet) * header.meshletCount > fileSize ||
+      header.nodesOffset + sizeof(MeshNode) * header.nodeCount > fileSize ||
+      header.nodeMeshesOffset + sizeof(uint32_t) * header.nodeMeshCount > fileSize)
+  {
+    return false;
+  }
+
+  // Files touched without being changed (copied, checked out again) keep their cache
+  const uint64_t sourceStamp = StampModelFiles(modelFile);
+  const bool stampChanged = header.sourceStamp != sourceStamp;
+  if (stampChanged && header.sourceHash != HashModelFiles(modelFile))
+  {
+    return false;
+  }
+
+  fileData.resize(fileSize);
+  file.seekg(0);
+  file.read(fileData.data(), fileSize);
+  if (!file)
+  {
+    fileData.clear();
+    return false;
+  }
+
+  // Only the texture names need to be copied out, they are few and small
+  textureNames.clear();
+  const char* names = fileData.data() + header.textureNamesOffset;
+  const char* namesEnd = names + header.textureNamesSize;
+  while (names < namesEnd)
+  {
+    textureNames.push_back(names);
+    names += textureNames.back().size() + 1;
+  }
+
+  setSections();
+  if (!checkSections())
+  {
+    fileData.clear();
+    meshCount = 0;
+    nodeCount = 0;
+    nodeMeshCount = 0;
+    return false;
+  }
+
+  // Only the header is written again, failing to do so just means hashing the files on the next load too
+  if (stampChanged)
+  {
+    file.close();
+    std::fstream headerFile(cacheFile, std::ios::binary | std::ios::in | std::ios::out);
+    if (headerFile.is_open())
+    {
+      header.sourceStamp = sourceStamp;
+      headerFile.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    }
+  }
+
+  return true;
+}
+
+bool MeshCache::save(const std::string& cacheFile, const std::string& modelFile, uint32_t importFlags) const
+{
+  if (fileData.size() < sizeof(Header))
+  {
+    return false;
+  }
+
+  std::ofstream file(cacheFile, std::ios::binary | std::ios::trunc);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  // Key is only known by the caller, patch it in the header while writing
+  Header header;
+  memcpy(&header, fileData.data(), sizeof(Header));
+  header.sourceHash = HashModelFiles(modelFile);
+  header.sourceStamp = StampModelFiles(modelFile);
+  header.importFlags = importFlags;
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  file.write(fileData.data() + sizeof(Header), fileData.size() - sizeof(Header));
+
+  return file.good();
+}
+
+void MeshCache::addMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                        const std::vector<MeshLod>& lods, const std::vector<Meshlet>& meshlets, uint32_t materialIndex,
+                        const BoundingSphere& bounds)
+{
+  MeshRange range = {};
+  range.firstVertex = static_cast<uint32_t>(newVertices.size());
+  range.vertexCount = static_cast<uint32_t>(vertices.size());
+  range.firstIndex = static_cast<uint32_t>(newIndices.size());
+  range.indexCount = static_cast<uint32_t>(indices.size());
+  range.materialIndex = materialIndex;
+  range.bounds = bounds;
+  assert(!lods.empty() && lods.size() <= MAX_MESH_LODS);
+  range.lodCount = static_cast<uint32_t>(lods.size());
+  std::copy(lods.begin(), lods.end(), range.lods);
+  range.firstMeshlet = static_cast<uint32_t>(newMeshlets.size());
+  range.meshletCount = static_cast<uint32_t>(meshlets.size());
+  newMeshRanges.push_back(range);
+
+  newVertices.insert(newVertices.end(), vertices.begin(), vertices.end());
+  newIndices.insert(newIndices.end(), indices.begin(), indices.end());
+  newMeshlets.insert(newMeshlets.end(), meshlets.begin(), meshlets.end());
+}
+
+uint32_t MeshCache::addNode(const glm::mat4& transform, int32_t parent, const std::vector<uint32_t>& meshes)
+{
+  assert(parent < static_cast<int32_t>(newNodes.size()));
+
+  MeshNode node = {};
+  node.transform = transform;
+  node.parent = parent;
+  node.firstMesh = static_cast<uint32_t>(newNodeMeshes.size());
+  node.meshCount = static_cast<uint32_t>(meshes.size());
+  newNodes.push_back(node);
+
+  newNodeMeshes.insert(newNodeMeshes.end(), meshes.begin(), meshes.end());
+
+  return static_cast<uint32_t>(newNodes.size() - 1);
+}
+
+void MeshCache::build()
+{
+  std::string textureNameTable;
+  for (const auto& name : textureNames)
+  {
+    textureNameTable += name;
+    textureNameTable.push_back('\0');
+  }
+
+  Header header = {};
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.meshCount = static_cast<uint32_t>(newMeshRanges.size());
+  header.vertexCount = static_cast<uint32_t>(newVertices.size());
+  header.indexCount = static_cast<uint32_t>(newIndices.size());
+  header.meshletCount = static_cast<uint32_t>(newMeshlets.size());
+  header.nodeCount = static_cast<uint32_t>(newNodes.size());
+  header.nodeMeshCount = static_cast<uint32_t>(newNodeMeshes.size());
+  header.textureNamesOffset = alignOffset(sizeof(Header));
+  header.textureNamesSize = textureNameTable.size();
+  header.meshRangesOffset = alignOffset(header.textureNamesOffset + header.textureNamesSize);
+  header.verticesOffset = alignOffset(header.meshRangesOffset + sizeof(MeshRange) * newMeshRanges.size());
+  header.indicesOffset = alignOffset(header.verticesOffset + sizeof(Vertex) * newVertices.size());
+  header.meshletsOffset = alignOffset(header.indicesOffset + sizeof(uint32_t) * newIndices.size());
+  header.nodesOffset = alignOffset(header.meshletsOffset + sizeof(Meshlet) * newMeshlets.size());
+  header.nodeMeshesOffset = alignOffset(header.nodesOffset + sizeof(MeshNode) * newNodes.size());
+  header.fileSize = header.nodeMeshesOffset + sizeof(uint32_t) * newNodeMeshes.size();
+
+  fileData.assign(header.fileSize, 0);
+  memcpy(fileData.data(), &header, sizeof(Header));
+  memcpy(fileData.data() + header.textureNamesOffset, textureNameTable.data(), textureNameTable.size());
+  memcpy(fileData.data() + header.meshRangesOffset, newMeshRanges.data(), sizeof(MeshRange) * newMeshRanges.size());
+  memcpy(fileData.data() + header.verticesOffset, newVertices.data(), sizeof(Vertex) * newVertices.size());
+  memcpy(fileData.data() + header.indicesOffset, newIndices.data(), sizeof(uint32_t) * newIndices.size());
+  memcpy(fileData.data() + header.meshletsOffset, newMeshlets.data(), sizeof(Meshlet) * newMeshlets.size());
+  memcpy(fileData.data() + header.nodesOffset, newNodes.data(), sizeof(MeshNode) * newNodes.size());
+  memcpy(fileData.data() + header.nodeMeshesOffset, newNodeMeshes.data(), sizeof(uint32_t) * newNodeMeshes.size());
+
+  newMeshRanges.clear();
+  newVertices.clear();
+  newIndices.clear();
+  newMeshlets.clear();
+  newNodes.clear();
+  newNodeMeshes.clear();
+
+  setSections();
+}
+
+void MeshCache::setSections()
+{
+  const Header* header = reinterpret_cast<const Header*>(fileData.data());
+
+  meshCount = header->meshCount;
+  meshRanges = reinterpret_cast<const MeshRange*>(fileData.data() + header->meshRangesOffset);
+  vertexData = reinterpret_cast<const Vertex*>(fileData.data() + header->verticesOffset);
+  indexData = reinterpret_cast<const uint32_t*>(fileData.data() + header->indicesOffset);
+  meshletData = reinterpret_cast<const Meshlet*>(fileData.data() + header->meshletsOffset);
+  nodeCount = header->nodeCount;
+  nodeData = reinterpret_cast<const MeshNode*>(fileData.data() + header->nodesOffset);
+  nodeMeshCount = header->nodeMeshCount;
+  nodeMeshData = reinterpret_cast<const uint32_t*>(fileData.data() + header->nodeMeshesOffset);
+}
+
+bool MeshCache::checkSections() const
+{
+  const Header* header = reinterpret_cast<const Header*>(fileData.data());
+
+  for (size_t i = 0; i < meshCount; ++i)
+  {
+    const MeshRange& range = meshRanges[i];
+    if (static_cast<uint64_t>(range.firstVertex) + range.vertexCount > header->vertexCount ||
+        static_cast<uint64_t>(range.firstIndex) + range.indexCount > header->indexCount ||
+        static_cast<uint64_t>(range.firstMeshlet) + range.meshletCount > header->meshletCount ||
+        range.materialIndex >= textureNames.size() ||
+        range.lodCount == 0 || range.lodCount > MAX_MESH_LODS)
+    {
+      return false;
+    }
+
+    for (uint32_t lod = 0; lod < range.lodCount; ++lod)
+    {
+      if (static_cast<uint64_t>(range.lods[lod].firstIndex) + range.lods[lod].indexCount > range.indexCount)
+      {
+        return false;
+      }
+    }
+
+    // Indices are relative to the mesh's first vertex
+    const uint32_t* indices = getIndices(range);
+    for (uint32_t j = 0; j < range.indexCount; ++j)
+    {
+      if (indices[j] >= range.vertexCount)
+      {
+        return false;
+      }
+    }
+
+    for (uint32_t j = 0; j < range.meshletCount; ++j)
+    {
+      const Meshlet& meshlet = meshletData[range.firstMeshlet + j];
+      if (static_cast<uint64_t>(meshlet.firstIndex) + meshlet.indexCount > range.indexCount)
+      {
+        return false;
+      }
+    }
+  }
+
+  // Nodes are depth first, so the scene graph can add them in order: a node's parent is on the chain of ancestors
+  // of the node before it
+  std::vector<int32_t> ancestors;
+  for (size_t i = 0; i < nodeCount; ++i)
+  {
+    const MeshNode& node = nodeData[i];
+    while (!ancestors.empty() && ancestors.back() != node.parent)
+    {
+      ancestors.pop_back();
+    }
+    if ((node.parent >= 0 && ancestors.empty()) ||
+        static_cast<uint64_t>(node.firstMesh) + node.meshCount > nodeMeshCount)
+    {
+      return false;
+    }
+    ancestors.push_back(static_cast<int32_t>(i));
+  }
+
+  for (size_t i = 0; i < nodeMeshCount; ++i)
+  {
+    if (nodeMeshData[i] >= meshCount)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
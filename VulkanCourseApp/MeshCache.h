@@ -0,0 +1,119 @@
+#pragma once
+
+#include "Utilities.h"
+
+#include <string>
+#include <vector>
+
+// Binary copy of an imported model, written the first time a model is imported with Assimp and
+// loaded back on later runs. The file is a header followed by 16 bytes aligned sections, so it is
+// read in a single call and used in place without any parsing (the layout can be memory mapped).
+class MeshCache
+{
+public:
+  static const uint32_t MAGIC = 0x4843454D;     // "MECH"
+  static const uint32_t VERSION = 7;
+
+  // Location of a submesh in the shared vertex and index blobs, its LODs follow each other in its indices
+  struct MeshRange
+  {
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t materialIndex;
+    BoundingSphere bounds;
+    uint32_t lodCount;
+    MeshLod lods[MAX_MESH_LODS];    // First index relative to the submesh indices
+    uint32_t firstMeshlet;          // Meshlets of the full detail LOD
+    uint32_t meshletCount;
+  };
+
+  MeshCache();
+
+  // Hash of the model file and of its material library (.mtl with the same name), used as cache key
+  static uint64_t HashModelFiles(const std::string& modelFile);
+  // Hash of the sizes and modification times of the same files, cheap enough to check on every load
+  static uint64_t StampModelFiles(const std::string& modelFile);
+
+  // Returns false if the cache file is missing, or was written for another source, import flags or version.
+  // The source files are only hashed when their stamp changed, a matching hash refreshes the stamp of the cache.
+  bool load(const std::string& cacheFile, const std::string& modelFile, uint32_t importFlags);
+  bool save(const std::string& cacheFile, const std::string& modelFile, uint32_t importFlags) const;
+
+  // Building a new cache from imported data, build() must be called once all meshes were added
+  void setTextureNames(const std::vector<std::string>& newTextureNames) { textureNames = newTextureNames; }
+  void addMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<MeshLod>& lods,
+               const std::vector<Meshlet>& meshlets, uint32_t materialIndex, const BoundingSphere& bounds);
+  // Nodes must be added parents first, in depth first order. Returns the index of the node.
+  uint32_t addNode(const glm::mat4& transform, int32_t parent, const std::vector<uint32_t>& meshes);
+  void build();
+
+  const std::vector<std::string>& getTextureNames() const { return textureNames; }
+
+  size_t getMeshCount() const { return meshCount; }
+  const MeshRange& getMeshRange(size_t index) const { assert(index < meshCount); return meshRanges[index]; }
+
+  const Vertex* getVertices(const MeshRange& range) const { return vertexData + range.firstVertex; }
+  const uint32_t* getIndices(const MeshRange& range) const { return indexData + range.firstIndex; }
+  const Meshlet* getMeshlets(const MeshRange& range) const { return meshletData + range.firstMeshlet; }
+
+  size_t getNodeCount() const { return nodeCount; }
+  const MeshNode* getNodes() const { return nodeData; }
+  size_t getNodeMeshCount() const { return nodeMeshCount; }
+  const uint32_t* getNodeMeshes() const { return nodeMeshData; }
+
+private:
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t sourceStamp;
+    uint32_t importFlags;
+    uint32_t meshCount;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t meshletCount;
+    uint32_t nodeCount;
+    uint32_t nodeMeshCount;
+    uint32_t padding;
+    uint64_t textureNamesOffset;     // Texture names separated by '\0', one per material
+    uint64_t textureNamesSize;
+    uint64_t meshRangesOffset;
+    uint64_t verticesOffset;
+    uint64_t indicesOffset;
+    uint64_t meshletsOffset;
+    uint64_t nodesOffset;
+    uint64_t nodeMeshesOffset;       // Mesh indices of the nodes
+    uint64_t fileSize;
+  };
+
+  // Whole cache file, sections below point inside of it
+  std::vector<char> fileData;
+
+  std::vector<std::string> textureNames;
+
+  size_t meshCount;
+  const MeshRange* meshRanges;
+  const Vertex* vertexData;
+  const uint32_t* indexData;
+  const Meshlet* meshletData;
+  size_t nodeCount;
+  const MeshNode* nodeData;
+  size_t nodeMeshCount;
+  const uint32_t* nodeMeshData;
+
+  // Data accumulated by addMesh() until build() lays it out like the cache file
+  std::vector<MeshRange> newMeshRanges;
+  std::vector<Vertex> newVertices;
+  std::vector<uint32_t> newIndices;
+  std::vector<Meshlet> newMeshlets;
+  std::vector<MeshNode> newNodes;
+  std::vector<uint32_t> newNodeMeshes;
+
+  void setSections();
+  // Ranges and indices must stay inside of their sections and nodes must be depth first, the cache is read in place
+  // without further checks
+  bool checkSections() const;
+};
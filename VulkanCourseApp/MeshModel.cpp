@@ -1,19 +1,30 @@
 #include "Mesh.h"
+#include "MeshCache.h"
 #include "MeshModel.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "SceneGraph.h"
 
 #include <assimp/scene.h>
+#include <glm/packing.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
-MeshModel::MeshModel(const std::vector<Mesh*>& newMeshList)
-: model(glm::mat4(1.0f))
-{
-  meshList.reserve(newMeshList.size());
+#include <algorithm>
+#include <cmath>
+
+// Meshes are not simplified below this many indices, their draws cost little already
+static const size_t MIN_LOD_INDEX_COUNT = 64 * 3;
 
-  for (auto& mesh : newMeshList)
+MeshModel::MeshModel(const std::shared_ptr<MeshAsset>& newAsset, SceneGraph& sceneGraph)
+: asset(newAsset)
+{
+  // Asset nodes are stored parents first like the scene graph, they keep their order under the model's root
+  rootNode = sceneGraph.addNode(-1, glm::mat4(1.0f));
+  for (size_t i = 0; i < asset->getNodeCount(); ++i)
   {
-    if (mesh)
-    {
-      meshList.push_back(mesh);
-    }
+    const MeshNode& node = asset->getNode(i);
+    sceneGraph.addNode(node.parent < 0 ? rootNode : getSceneNode(node.parent), node.transform);
   }
 }
 
@@ -24,11 +35,8 @@ MeshModel::~MeshModel()
 
 void MeshModel::destroyMeshModel()
 {
-  for (auto& mesh : meshList)
-  {
-    mesh->destroyBuffers();
-  }
-  meshList.clear();
+  // Meshes are destroyed with the asset, once no other model uses them
+  asset.reset();
 }
 
 std::vector<std::string> MeshModel::LoadMaterials(const aiScene* scene)
@@ -60,32 +68,22 @@ std::vector<std::string> MeshModel::LoadMaterials(const aiScene* scene)
   return textureList;
 }
 
-std::vector<Mesh*> MeshModel::LoadNode(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
-                                       VkCommandPool transferCommandPool, aiNode* node, const aiScene* scene,
-                                       const std::vector<int>& matToTex, VkAllocationCallbacks* callback)
+void MeshModel::LoadNode(aiNode* node, int32_t parent, MeshCache& meshCache)
 {
-  std::vector<Mesh*> meshList;
-  for (size_t i = 0; i < node->mNumMeshes; ++i)
-  {
-    Mesh* mesh = LoadMesh(newPhysicalDevice, newDevice, transferQueue, transferCommandPool, scene->mMeshes[node->mMeshes[i]], scene, matToTex, callback);
-    if (mesh)
-    {
-      meshList.push_back(mesh);
-    }
-  }
+  // Meshes are added in the scene order, a node refers to them by their scene index
+  std::vector<uint32_t> meshes(node->mMeshes, node->mMeshes + node->mNumMeshes);
+
+  // Assimp matrices are row major
+  glm::mat4 transform = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+  uint32_t nodeIndex = meshCache.addNode(transform, parent, meshes);
 
   for (size_t i = 0; i < node->mNumChildren; ++i)
   {
-    std::vector<Mesh*> newList = LoadNode(newPhysicalDevice, newDevice, transferQueue, transferCommandPool, node->mChildren[i], scene, matToTex, callback);
-    meshList.insert(meshList.end(), newList.begin(), newList.end());
+    LoadNode(node->mChildren[i], static_cast<int32_t>(nodeIndex), meshCache);
   }
-
-  return meshList;
 }
 
-Mesh* MeshModel::LoadMesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
-                          VkCommandPool transferCommandPool, aiMesh* mesh, const aiScene* scene,
-                          const std::vector<int>& matToTex, VkAllocationCallbacks* callback)
+void MeshModel::LoadMesh(aiMesh* mesh, const aiScene* scene, MeshCache& meshCache)
 {
   std::vector<Vertex> vertices(mesh->mNumVertices);
   std::vector<uint32_t> indices;
@@ -105,6 +103,10 @@ Mesh* MeshModel::LoadMesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice
     {
       vertices[i].col = { mesh->mColors[0][i].r, mesh->mColors[0][i].g, mesh->mColors[0][i].b };
     }
+    else
+    {
+      vertices[i].col = { 0.0f, 0.0f, 0.0f };
+    }
   }
 
   for (size_t i = 0; i < mesh->mNumFaces; ++i)
@@ -116,7 +118,164 @@ Mesh* MeshModel::LoadMesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice
     }
   }
 
-  return new Mesh(newPhysicalDevice, newDevice, transferQueue, transferCommandPool, vertices, indices,
-                  matToTex[mesh->mMaterialIndex], callback);
+  // Points and lines left by the triangulation keep their order, and have no LOD or meshlet
+  std::vector<MeshLod> lods = { { 0, static_cast<uint32_t>(indices.size()), 0.0f } };
+  std::vector<Meshlet> meshlets;
+  if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+  {
+    MeshOptimizer::Optimize(vertices, indices);
+    MeshOptimizer::BuildMeshlets(vertices, indices.data(), indices.size(), meshlets);
+    BuildLods(vertices, indices, lods);
+  }
+
+  meshCache.addMesh(vertices, indices, lods, meshlets, mesh->mMaterialIndex, ComputeBounds(vertices));
+}
+
+void MeshModel::BuildLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods)
+{
+  // Each LOD has about half the triangles of the previous one, the simplification goes on from it
+  MeshSimplifier simplifier(vertices, indices);
+  std::vector<uint32_t> lodIndices;
+  while (lods.size() < MAX_MESH_LODS)
+  {
+    const MeshLod& previous = lods.back();
+    size_t targetIndexCount = previous.indexCount / 6 * 3;
+    if (targetIndexCount < MIN_LOD_INDEX_COUNT)
+    {
+      break;
+    }
+
+    simplifier.simplify(targetIndexCount);
+
+    // Borders and seams are kept, meshes made of them can't be reduced much
+    if (simplifier.getIndexCount() > previous.indexCount * 3 / 4)
+    {
+      break;
+    }
+
+    simplifier.getIndices(lodIndices);
+    MeshOptimizer::OptimizeVertexCache(lodIndices, vertices.size());
+
+    lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lodIndices.size()), simplifier.getError() });
+    indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+  }
+}
+
+BoundingSphere MeshModel::ComputeBounds(const std::vector<Vertex>& vertices)
+{
+  BoundingSphere bounds = { glm::vec3(0.0f), 0.0f };
+  if (vertices.empty())
+  {
+    return bounds;
+  }
+
+  // Center of the bounding box, then the farthest vertex from it
+  glm::vec3 minPos = vertices[0].pos;
+  glm::vec3 maxPos = vertices[0].pos;
+  for (const auto& vertex : vertices)
+  {
+    minPos = glm::min(minPos, vertex.pos);
+    maxPos = glm::max(maxPos, vertex.pos);
+  }
+  bounds.center = (minPos + maxPos) * 0.5f;
+
+  float radiusSquared = 0.0f;
+  for (const auto& vertex : vertices)
+  {
+    glm::vec3 offset = vertex.pos - bounds.center;
+    radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+  }
+  bounds.radius = std::sqrt(radiusSquared);
+
+  return bounds;
+}
+
+void MeshModel::PackVertices(const Vertex* vertices, size_t vertexCount, std::vector<PackedVertex>& packedVertices,
+                             glm::vec3& positionScale, glm::vec3& positionBias)
+{
+  packedVertices.resize(vertexCount);
+  positionScale = glm::vec3(1.0f);
+  positionBias = glm::vec3(0.0f);
+  if (vertexCount == 0)
+  {
+    return;
+  }
+
+  // Positions are stored relative to the bounding box, 16 bits per axis over its extent
+  glm::vec3 minPos = vertices[0].pos;
+  glm::vec3 maxPos = vertices[0].pos;
+  for (size_t i = 0; i < vertexCount; ++i)
+  {
+    minPos = glm::min(minPos, vertices[i].pos);
+    maxPos = glm::max(maxPos, vertices[i].pos);
+  }
+  positionScale = glm::max(maxPos - minPos, glm::vec3(1e-6f));
+  positionBias = minPos;
+
+  for (size_t i = 0; i < vertexCount; ++i)
+  {
+    packedVertices[i].pos = glm::packUnorm4x16(glm::vec4((vertices[i].pos - positionBias) / positionScale, 0.0f));
+    packedVertices[i].col = glm::packUnorm4x8(glm::vec4(vertices[i].col, 1.0f));
+    packedVertices[i].tex = glm::packHalf2x16(vertices[i].tex);
+  }
 }
 
+std::vector<Mesh*> MeshModel::CreateMeshes(VkDevice newDevice, DeviceAllocator& allocator, GeometryArena& arena,
+                                           VkQueue transferQueue, VkCommandPool transferCommandPool,
+                                           const MeshCache& meshCache, const std::vector<int>& matToTex,
+                                           VertexFormat vertexFormat, VkAllocationCallbacks* callback)
+{
+  std::vector<Mesh*> meshList;
+  meshList.reserve(meshCache.getMeshCount());
+
+  // Size the staging buffer to hold every mesh so the whole model is uploaded with a single submit
+  VkDeviceSize stagingSize = 0;
+  for (size_t i = 0; i < meshCache.getMeshCount(); ++i)
+  {
+    const MeshCache::MeshRange& range = meshCache.getMeshRange(i);
+    stagingSize += sizeof(Vertex) * range.vertexCount + sizeof(uint32_t) * range.indexCount + sizeof(Meshlet) * range.meshletCount +
+                   3 * 16;    // Alignment padding between uploads
+  }
+
+  UploadBatch uploadBatch(newDevice, allocator, transferQueue, transferCommandPool, stagingSize, callback);
+
+  // The batch copies the data to its staging buffer, packed vertices and indices can be reused for the next mesh
+  std::vector<PackedVertex> packedVertices;
+  std::vector<uint16_t> shortIndices;
+  for (size_t i = 0; i < meshCache.getMeshCount(); ++i)
+  {
+    const MeshCache::MeshRange& range = meshCache.getMeshRange(i);
+    const void* vertices = meshCache.getVertices(range);
+    glm::vec3 positionScale(1.0f);
+    glm::vec3 positionBias(0.0f);
+    if (vertexFormat == VertexFormat::Packed)
+    {
+      PackVertices(meshCache.getVertices(range), range.vertexCount, packedVertices, positionScale, positionBias);
+      vertices = packedVertices.data();
+    }
+
+    // Indices are relative to the mesh vertices, under 65536 vertices they fit in 16 bits
+    const void* indices = meshCache.getIndices(range);
+    VkIndexType indexType = GeometryArena::IndexTypeFor(range.vertexCount);
+    if (indexType == VK_INDEX_TYPE_UINT16)
+    {
+      const uint32_t* meshIndices = meshCache.getIndices(range);
+      shortIndices.resize(range.indexCount);
+      for (uint32_t j = 0; j < range.indexCount; ++j)
+      {
+        shortIndices[j] = static_cast<uint16_t>(meshIndices[j]);
+      }
+      indices = shortIndices.data();
+    }
+
+    meshList.push_back(new Mesh(arena, uploadBatch,
+                                vertices, range.vertexCount,
+                                indices, range.indexCount, indexType, range.lods, range.lodCount,
+                                meshCache.getMeshlets(range), range.meshletCount,
+                                range.bounds, positionScale, positionBias, matToTex[range.materialIndex]));
+  }
+
+  uploadBatch.submit();
+
+  return meshList;
+}
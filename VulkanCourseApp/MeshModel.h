@@ -2,36 +2,55 @@
 
 #include <glm/glm.hpp>
 
+#include <memory>
 #include <vector>
 
+#include "MeshAsset.h"
+
 struct aiMesh;
 struct aiNode;
 struct aiScene;
+class DeviceAllocator;
+class GeometryArena;
 class Mesh;
+class MeshCache;
+class SceneGraph;
 
 class MeshModel
 {
 public:
-  MeshModel(const std::vector<Mesh*>& newMeshList);
+  // Adds a root node for the model to the scene graph, with the nodes of the asset under it
+  MeshModel(const std::shared_ptr<MeshAsset>& newAsset, SceneGraph& sceneGraph);
   ~MeshModel();
 
-  size_t getMeshCount() const { return meshList.size(); }
-  Mesh* getMesh(size_t index) const { assert(index < meshList.size()); return meshList[index]; }
+  // Meshes are shared with the other models created from the same file
+  size_t getMeshCount() const { return asset ? asset->getMeshCount() : 0; }
+  Mesh* getMesh(size_t index) const { return asset->getMesh(index); }
+  const std::shared_ptr<MeshAsset>& getAsset() const { return asset; }
 
-  const glm::mat4 getModelMatrix() const { return model; }
-  void setModelMatrix(const glm::mat4& newModel) { model = newModel; }
+  // Scene graph node holding the model matrix, and the one of each asset node
+  uint32_t getRootNode() const { return rootNode; }
+  uint32_t getSceneNode(size_t assetNode) const { return rootNode + 1 + static_cast<uint32_t>(assetNode); }
 
   void destroyMeshModel();
 
   static std::vector<std::string> LoadMaterials(const aiScene* scene);
-  static std::vector<Mesh*> LoadNode(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
-                                     VkCommandPool transferCommandPool, aiNode* node, const aiScene* scene,
-                                     const std::vector<int>& matToTex, VkAllocationCallbacks* callback);
-  static Mesh* LoadMesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue,
-                        VkCommandPool transferCommandPool, aiMesh* mesh, const aiScene* scene,
-                        const std::vector<int>& matToTex, VkAllocationCallbacks* callback);
+  // Add the node and its children to the cache depth first, with the meshes they draw
+  static void LoadNode(aiNode* node, int32_t parent, MeshCache& meshCache);
+  // Triangle meshes go through the optimizer before being added to the cache
+  static void LoadMesh(aiMesh* mesh, const aiScene* scene, MeshCache& meshCache);
+  // Append the indices of the simplified LODs after the full detail ones
+  static void BuildLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods);
+  static BoundingSphere ComputeBounds(const std::vector<Vertex>& vertices);
+  // Quantize the vertices of a mesh, packed positions map back to model space with position * scale + bias
+  static void PackVertices(const Vertex* vertices, size_t vertexCount, std::vector<PackedVertex>& packedVertices,
+                           glm::vec3& positionScale, glm::vec3& positionBias);
+  static std::vector<Mesh*> CreateMeshes(VkDevice newDevice, DeviceAllocator& allocator, GeometryArena& arena,
+                                         VkQueue transferQueue, VkCommandPool transferCommandPool,
+                                         const MeshCache& meshCache, const std::vector<int>& matToTex,
+                                         VertexFormat vertexFormat, VkAllocationCallbacks* callback);
 
 private:
-  std::vector<Mesh*> meshList;
-  glm::mat4 model;
+  std::shared_ptr<MeshAsset> asset;
+  uint32_t rootNode;
 };
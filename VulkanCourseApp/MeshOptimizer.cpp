@@ -0,0 +1,432 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Clusters are split while their cache miss ratio stays within this factor of the cache optimized order
+static const float OVERDRAW_THRESHOLD = 1.05f;
+
+static const uint32_t NO_VERTEX = ~0u;
+
+// FIFO cache simulation: a vertex is cached if fewer than CACHE_SIZE vertices were transformed since its own
+// transform. Hits don't refresh the entry, and advancing the time by more than the cache size flushes it.
+class FifoCache
+{
+public:
+  explicit FifoCache(size_t vertexCount)
+  : cacheTime(vertexCount, 0)
+  , time(MeshOptimizer::CACHE_SIZE + 1)
+  {
+  }
+
+  bool isCached(uint32_t vertex) const { return time - cacheTime[vertex] <= MeshOptimizer::CACHE_SIZE; }
+  uint32_t getAge(uint32_t vertex) const { return time - cacheTime[vertex]; }
+
+  // Returns true on a miss
+  bool fetch(uint32_t vertex)
+  {
+    if (isCached(vertex))
+    {
+      return false;
+    }
+    cacheTime[vertex] = time++;
+    return true;
+  }
+
+  uint32_t fetchTriangle(const uint32_t* triangle)
+  {
+    return fetch(triangle[0]) + fetch(triangle[1]) + fetch(triangle[2]);
+  }
+
+  void flush() { time += MeshOptimizer::CACHE_SIZE + 1; }
+
+private:
+  std::vector<uint32_t> cacheTime;
+  uint32_t time;
+};
+
+// Bounding sphere of the meshlet vertices, and the cone containing its triangle normals
+static void computeMeshletBounds(const std::vector<Vertex>& vertices, const uint32_t* indices, Meshlet& meshlet)
+{
+  const uint32_t* meshletIndices = indices + meshlet.firstIndex;
+
+  glm::vec3 minPos = vertices[meshletIndices[0]].pos;
+  glm::vec3 maxPos = minPos;
+  for (uint32_t i = 0; i < meshlet.indexCount; ++i)
+  {
+    minPos = glm::min(minPos, vertices[meshletIndices[i]].pos);
+    maxPos = glm::max(maxPos, vertices[meshletIndices[i]].pos);
+  }
+  glm::vec3 center = (minPos + maxPos) * 0.5f;
+
+  float radiusSquared = 0.0f;
+  for (uint32_t i = 0; i < meshlet.indexCount; ++i)
+  {
+    glm::vec3 offset = vertices[meshletIndices[i]].pos - center;
+    radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+  }
+
+  std::vector<glm::vec3> normals;
+  normals.reserve(meshlet.indexCount / 3);
+  glm::vec3 normalSum(0.0f);
+  for (uint32_t i = 0; i < meshlet.indexCount; i += 3)
+  {
+    const glm::vec3& p0 = vertices[meshletIndices[i]].pos;
+    glm::vec3 normal = glm::cross(vertices[meshletIndices[i + 1]].pos - p0, vertices[meshletIndices[i + 2]].pos - p0);
+    float length = glm::length(normal);
+    if (length > 0.0f)
+    {
+      normals.push_back(normal / length);
+      normalSum += normals.back();
+    }
+  }
+
+  // A cutoff of 1 never culls
+  glm::vec3 axis(0.0f);
+  float cutoff = 1.0f;
+  float axisLength = glm::length(normalSum);
+  if (axisLength > 0.0f)
+  {
+    axis = normalSum / axisLength;
+    float minDot = 1.0f;
+    for (const auto& normal : normals)
+    {
+      minDot = std::min(minDot, glm::dot(axis, normal));
+    }
+
+    // Normals spread past about 84 degrees from the axis leave too few directions facing away from all of them
+    if (minDot > 0.1f)
+    {
+      cutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+  }
+
+  meshlet.sphere = glm::vec4(center, std::sqrt(radiusSquared));
+  meshlet.cone = glm::vec4(axis, cutoff);
+}
+
+void MeshOptimizer::Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+  OptimizeVertexCache(indices, vertices.size());
+  OptimizeOverdraw(vertices, indices);
+  OptimizeVertexFetch(vertices, indices);
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount)
+{
+  CacheStats stats;
+  stats.triangleCount = indices.size() / 3;
+  stats.vertexCount = vertexCount;
+
+  FifoCache cache(vertexCount);
+  for (uint32_t index : indices)
+  {
+    stats.misses += cache.fetch(index);
+  }
+
+  return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0)
+  {
+    return;
+  }
+
+  // Triangles using each vertex, the live count drops as they are emitted
+  std::vector<uint32_t> liveCount(vertexCount, 0);
+  for (uint32_t index : indices)
+  {
+    ++liveCount[index];
+  }
+
+  std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+  for (size_t i = 0; i < vertexCount; ++i)
+  {
+    adjacencyOffsets[i + 1] = adjacencyOffsets[i] + liveCount[i];
+  }
+
+  std::vector<uint32_t> adjacency(indices.size());
+  std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+  for (size_t i = 0; i < indices.size(); ++i)
+  {
+    adjacency[adjacencyFill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+
+  // Tipsify: emit every triangle around a fanning vertex, then fan around the vertex of those triangles that
+  // is still used by others and stays in the cache the longest. Dead ends restart from the most recently
+  // emitted vertex with live triangles, or the next one in index order.
+  FifoCache cache(vertexCount);
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<uint32_t> deadEndStack;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> output;
+  deadEndStack.reserve(indices.size());
+  output.reserve(indices.size());
+
+  uint32_t scanCursor = 0;
+  uint32_t fanning = 0;
+  while (fanning != NO_VERTEX)
+  {
+    candidates.clear();
+    for (uint32_t i = adjacencyOffsets[fanning]; i < adjacencyOffsets[fanning + 1]; ++i)
+    {
+      uint32_t triangle = adjacency[i];
+      if (emitted[triangle])
+      {
+        continue;
+      }
+      emitted[triangle] = true;
+
+      for (uint32_t k = 0; k < 3; ++k)
+      {
+        uint32_t vertex = indices[triangle * 3 + k];
+        output.push_back(vertex);
+        deadEndStack.push_back(vertex);
+        candidates.push_back(vertex);
+        --liveCount[vertex];
+        cache.fetch(vertex);
+      }
+    }
+
+    // A candidate is only worth fanning around if its remaining triangles fit before it leaves the cache
+    uint32_t next = NO_VERTEX;
+    int64_t bestPriority = -1;
+    for (uint32_t vertex : candidates)
+    {
+      if (liveCount[vertex] == 0)
+      {
+        continue;
+      }
+
+      int64_t priority = 0;
+      if (cache.getAge(vertex) + 2 * liveCount[vertex] <= CACHE_SIZE)
+      {
+        priority = cache.getAge(vertex);
+      }
+      if (priority > bestPriority)
+      {
+        bestPriority = priority;
+        next = vertex;
+      }
+    }
+
+    while (next == NO_VERTEX && !deadEndStack.empty())
+    {
+      uint32_t vertex = deadEndStack.back();
+      deadEndStack.pop_back();
+      if (liveCount[vertex] > 0)
+      {
+        next = vertex;
+      }
+    }
+
+    while (next == NO_VERTEX && scanCursor < vertexCount)
+    {
+      if (liveCount[scanCursor] > 0)
+      {
+        next = scanCursor;
+      }
+      else
+      {
+        ++scanCursor;
+      }
+    }
+
+    fanning = next;
+  }
+
+  indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeOverdraw(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0)
+  {
+    return;
+  }
+
+  // Clusters start where the cache optimized order jumps elsewhere on the mesh, all three vertices of the
+  // triangle miss the cache. Reordering them costs nothing more than starting them with an empty cache.
+  std::vector<uint32_t> hardBoundaries;
+  FifoCache cache(vertices.size());
+  for (uint32_t i = 0; i < triangleCount; ++i)
+  {
+    if (cache.fetchTriangle(&indices[i * 3]) == 3 || i == 0)
+    {
+      hardBoundaries.push_back(i);
+    }
+  }
+  hardBoundaries.push_back(static_cast<uint32_t>(triangleCount));
+
+  // Long clusters are split further where the part so far has a miss ratio close enough to the whole cluster,
+  // smaller clusters give a finer front to back order
+  std::vector<uint32_t> clusterStarts;
+  for (size_t c = 0; c + 1 < hardBoundaries.size(); ++c)
+  {
+    uint32_t start = hardBoundaries[c];
+    uint32_t end = hardBoundaries[c + 1];
+
+    cache.flush();
+    uint32_t clusterMisses = 0;
+    for (uint32_t i = start; i < end; ++i)
+    {
+      clusterMisses += cache.fetchTriangle(&indices[i * 3]);
+    }
+    float threshold = OVERDRAW_THRESHOLD * clusterMisses / (end - start);
+
+    cache.flush();
+    clusterStarts.push_back(start);
+    uint32_t subStart = start;
+    uint32_t misses = 0;
+    for (uint32_t i = start; i + 1 < end; ++i)
+    {
+      misses += cache.fetchTriangle(&indices[i * 3]);
+      if (static_cast<float>(misses) / (i + 1 - subStart) <= threshold)
+      {
+        clusterStarts.push_back(i + 1);
+        subStart = i + 1;
+        misses = 0;
+        cache.flush();
+      }
+    }
+  }
+  clusterStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+  glm::vec3 meshCentroid(0.0f);
+  for (const auto& vertex : vertices)
+  {
+    meshCentroid += vertex.pos;
+  }
+  meshCentroid /= static_cast<float>(std::max<size_t>(vertices.size(), 1));
+
+  // Clusters facing away from the mesh center are more likely to occlude the others, they are drawn first
+  struct ClusterOrder
+  {
+    float sortKey;
+    uint32_t cluster;
+  };
+  std::vector<ClusterOrder> order(clusterStarts.size() - 1);
+  for (uint32_t c = 0; c + 1 < clusterStarts.size(); ++c)
+  {
+    glm::vec3 normalSum(0.0f);
+    glm::vec3 centroidSum(0.0f);
+    float areaSum = 0.0f;
+    for (uint32_t i = clusterStarts[c]; i < clusterStarts[c + 1]; ++i)
+    {
+      const glm::vec3& p0 = vertices[indices[i * 3]].pos;
+      const glm::vec3& p1 = vertices[indices[i * 3 + 1]].pos;
+      const glm::vec3& p2 = vertices[indices[i * 3 + 2]].pos;
+
+      // Normal length is twice the area, both sums are area weighted
+      glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+      float area = glm::length(normal);
+      normalSum += normal;
+      centroidSum += (p0 + p1 + p2) * (area / 3.0f);
+      areaSum += area;
+    }
+
+    float normalLength = glm::length(normalSum);
+    order[c].cluster = c;
+    order[c].sortKey = 0.0f;
+    if (areaSum > 0.0f && normalLength > 0.0f)
+    {
+      order[c].sortKey = glm::dot(centroidSum / areaSum - meshCentroid, normalSum / normalLength);
+    }
+  }
+
+  std::stable_sort(order.begin(), order.end(), [](const ClusterOrder& a, const ClusterOrder& b)
+  {
+    return a.sortKey > b.sortKey;
+  });
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  for (const auto& cluster : order)
+  {
+    output.insert(output.end(), indices.begin() + clusterStarts[cluster.cluster] * 3,
+                  indices.begin() + clusterStarts[cluster.cluster + 1] * 3);
+  }
+
+  indices.swap(output);
+}
+
+void MeshOptimizer::BuildMeshlets(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount,
+                                  std::vector<Meshlet>& meshlets)
+{
+  meshlets.clear();
+
+  // Meshlet each vertex was last added to
+  std::vector<uint32_t> vertexMeshlet(vertices.size(), NO_VERTEX);
+  uint32_t meshletVertexCount = 0;
+  Meshlet meshlet = {};
+
+  for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+  {
+    uint32_t meshletIndex = static_cast<uint32_t>(meshlets.size());
+    uint32_t newVertexCount = 0;
+    for (uint32_t k = 0; k < 3; ++k)
+    {
+      newVertexCount += vertexMeshlet[indices[i + k]] != meshletIndex;
+    }
+
+    if (meshlet.indexCount > 0 &&
+        (meshletVertexCount + newVertexCount > MAX_MESHLET_VERTICES || meshlet.indexCount == MAX_MESHLET_TRIANGLES * 3))
+    {
+      computeMeshletBounds(vertices, indices, meshlet);
+      meshlets.push_back(meshlet);
+
+      ++meshletIndex;
+      meshlet = {};
+      meshlet.firstIndex = i;
+      meshletVertexCount = 0;
+    }
+
+    for (uint32_t k = 0; k < 3; ++k)
+    {
+      if (vertexMeshlet[indices[i + k]] != meshletIndex)
+      {
+        vertexMeshlet[indices[i + k]] = meshletIndex;
+        ++meshletVertexCount;
+      }
+    }
+    meshlet.indexCount += 3;
+  }
+
+  if (meshlet.indexCount > 0)
+  {
+    computeMeshletBounds(vertices, indices, meshlet);
+    meshlets.push_back(meshlet);
+  }
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+  // Vertices are numbered in the order of their first use, consecutive triangles read nearby memory
+  std::vector<uint32_t> remap(vertices.size(), NO_VERTEX);
+  std::vector<Vertex> fetchOrder;
+  fetchOrder.reserve(vertices.size());
+  for (auto& index : indices)
+  {
+    if (remap[index] == NO_VERTEX)
+    {
+      remap[index] = static_cast<uint32_t>(fetchOrder.size());
+      fetchOrder.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+
+  // Vertices no triangle uses keep their relative order at the end
+  for (size_t i = 0; i < vertices.size(); ++i)
+  {
+    if (remap[i] == NO_VERTEX)
+    {
+      fetchOrder.push_back(vertices[i]);
+    }
+  }
+
+  vertices.swap(fetchOrder);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Utilities.h"
+
+#include <vector>
+
+// Import time reordering of a mesh for the GPU: triangles are reordered for the post-transform vertex cache
+// (Tipsify), clusters of them are then sorted so the outward facing ones are drawn first to reduce overdraw,
+// and the vertices are renumbered in the order the triangles fetch them.
+class MeshOptimizer
+{
+public:
+  // Entries of the simulated FIFO post-transform cache, a conservative size for current GPUs
+  static const uint32_t CACHE_SIZE = 16;
+
+  struct CacheStats
+  {
+    uint64_t misses = 0;          // Vertices transformed
+    uint64_t triangleCount = 0;
+    uint64_t vertexCount = 0;
+
+    // Average cache miss ratio, vertices transformed per triangle (0.5 at best)
+    float getAcmr() const { return triangleCount > 0 ? static_cast<float>(misses) / triangleCount : 0.0f; }
+    // Average transform to vertex ratio, vertices transformed per vertex (1.0 at best)
+    float getAtvr() const { return vertexCount > 0 ? static_cast<float>(misses) / vertexCount : 0.0f; }
+  };
+
+  // Indices must be a triangle list, vertices and indices are reordered in place
+  static void Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+  // Simulates the cache over the indices, only meant for measurements since it costs a pass over them
+  static CacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount);
+  static void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+  static void OptimizeOverdraw(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+  static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+  // Split triangles in meshlets of consecutive triangles, with at most MAX_MESHLET_VERTICES vertices and
+  // MAX_MESHLET_TRIANGLES triangles each. The cache optimized order keeps their triangles close to each other.
+  static void BuildMeshlets(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount,
+                            std::vector<Meshlet>& meshlets);
+};
@@ -0,0 +1,261 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+void MeshSimplifier::Quadric::addPlane(const glm::vec3& normal, float distance, float planeWeight)
+{
+  a00 += planeWeight * normal.x * normal.x;
+  a01 += planeWeight * normal.x * normal.y;
+  a02 += planeWeight * normal.x * normal.z;
+  a11 += planeWeight * normal.y * normal.y;
+  a12 += planeWeight * normal.y * normal.z;
+  a22 += planeWeight * normal.z * normal.z;
+  b0 += planeWeight * normal.x * distance;
+  b1 += planeWeight * normal.y * distance;
+  b2 += planeWeight * normal.z * distance;
+  c += planeWeight * distance * distance;
+  weight += planeWeight;
+}
+
+void MeshSimplifier::Quadric::add(const Quadric& other)
+{
+  a00 += other.a00;
+  a01 += other.a01;
+  a02 += other.a02;
+  a11 += other.a11;
+  a12 += other.a12;
+  a22 += other.a22;
+  b0 += other.b0;
+  b1 += other.b1;
+  b2 += other.b2;
+  c += other.c;
+  weight += other.weight;
+}
+
+double MeshSimplifier::Quadric::evaluate(const glm::vec3& position) const
+{
+  if (weight <= 0.0)
+  {
+    return 0.0;
+  }
+
+  double x = position.x;
+  double y = position.y;
+  double z = position.z;
+  double result = a00 * x * x + a11 * y * y + a22 * z * z +
+                  2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+                  2.0 * (b0 * x + b1 * y + b2 * z) + c;
+  return std::max(result, 0.0) / weight;
+}
+
+MeshSimplifier::MeshSimplifier(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& newIndices)
+: indices(newIndices)
+, removed(newIndices.size() / 3, false)
+, vertexTriangles(vertices.size())
+, quadrics(vertices.size())
+, locked(vertices.size(), false)
+, liveTriangleCount(newIndices.size() / 3)
+, error(0.0f)
+{
+  positions.reserve(vertices.size());
+  for (const auto& vertex : vertices)
+  {
+    positions.push_back(vertex.pos);
+  }
+
+  // Edges used by a single triangle are on a border, or on a seam where the vertices are split
+  std::unordered_map<uint64_t, uint32_t> edgeUseCount;
+  for (uint32_t triangle = 0; triangle < liveTriangleCount; ++triangle)
+  {
+    const uint32_t* corners = &indices[triangle * 3];
+    for (uint32_t k = 0; k < 3; ++k)
+    {
+      uint32_t a = std::min(corners[k], corners[(k + 1) % 3]);
+      uint32_t b = std::max(corners[k], corners[(k + 1) % 3]);
+      ++edgeUseCount[(static_cast<uint64_t>(a) << 32) | b];
+
+      vertexTriangles[corners[k]].push_back(triangle);
+    }
+
+    const glm::vec3& p0 = positions[corners[0]];
+    glm::vec3 normal = glm::cross(positions[corners[1]] - p0, positions[corners[2]] - p0);
+    float area = glm::length(normal);
+    if (area > 0.0f)
+    {
+      normal /= area;
+      for (uint32_t k = 0; k < 3; ++k)
+      {
+        quadrics[corners[k]].addPlane(normal, -glm::dot(normal, p0), area);
+      }
+    }
+  }
+
+  for (const auto& edge : edgeUseCount)
+  {
+    if (edge.second == 1)
+    {
+      locked[static_cast<uint32_t>(edge.first >> 32)] = true;
+      locked[static_cast<uint32_t>(edge.first)] = true;
+    }
+  }
+
+  // Split vertices whose edges all have two triangles still meet other charts at their position
+  std::map<std::tuple<float, float, float>, uint32_t> firstAtPosition;
+  for (uint32_t i = 0; i < positions.size(); ++i)
+  {
+    auto result = firstAtPosition.insert({ std::make_tuple(positions[i].x, positions[i].y, positions[i].z), i });
+    if (!result.second)
+    {
+      locked[i] = true;
+      locked[result.first->second] = true;
+    }
+  }
+}
+
+void MeshSimplifier::simplify(size_t targetIndexCount)
+{
+  std::vector<Collapse> collapses;
+  std::vector<bool> touched(positions.size());
+
+  // Each pass collapses the cheapest edges of the current mesh, a vertex changes at most once per pass
+  // so the costs computed at the start of the pass stay valid
+  while (liveTriangleCount * 3 > targetIndexCount)
+  {
+    collapses.clear();
+    for (uint32_t triangle = 0; triangle < removed.size(); ++triangle)
+    {
+      if (removed[triangle])
+      {
+        continue;
+      }
+
+      const uint32_t* corners = &indices[triangle * 3];
+      for (uint32_t k = 0; k < 3; ++k)
+      {
+        uint32_t a = corners[k];
+        uint32_t b = corners[(k + 1) % 3];
+        Quadric quadric = quadrics[a];
+        quadric.add(quadrics[b]);
+        if (!locked[a])
+        {
+          collapses.push_back({ a, b, static_cast<float>(quadric.evaluate(positions[b])) });
+        }
+        if (!locked[b])
+        {
+          collapses.push_back({ b, a, static_cast<float>(quadric.evaluate(positions[a])) });
+        }
+      }
+    }
+
+    std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+    {
+      return a.cost < b.cost;
+    });
+
+    // Most collapses remove two triangles
+    size_t collapseBudget = (liveTriangleCount - targetIndexCount / 3 + 1) / 2;
+    size_t collapseCount = 0;
+    std::fill(touched.begin(), touched.end(), false);
+    for (const auto& collapse : collapses)
+    {
+      if (collapseCount >= collapseBudget)
+      {
+        break;
+      }
+      if (touched[collapse.from] || touched[collapse.to] || !isCollapseValid(collapse.from, collapse.to))
+      {
+        continue;
+      }
+
+      applyCollapse(collapse.from, collapse.to);
+      touched[collapse.from] = true;
+      touched[collapse.to] = true;
+      error = std::max(error, std::sqrt(collapse.cost));
+      ++collapseCount;
+    }
+
+    if (collapseCount == 0)
+    {
+      break;
+    }
+  }
+}
+
+void MeshSimplifier::getIndices(std::vector<uint32_t>& result) const
+{
+  result.clear();
+  result.reserve(liveTriangleCount * 3);
+  for (uint32_t triangle = 0; triangle < removed.size(); ++triangle)
+  {
+    if (!removed[triangle])
+    {
+      result.insert(result.end(), indices.begin() + triangle * 3, indices.begin() + triangle * 3 + 3);
+    }
+  }
+}
+
+bool MeshSimplifier::isCollapseValid(uint32_t from, uint32_t to) const
+{
+  // Triangles kept by the collapse must not flip
+  for (uint32_t triangle : vertexTriangles[from])
+  {
+    const uint32_t* corners = &indices[triangle * 3];
+    if (removed[triangle] || corners[0] == to || corners[1] == to || corners[2] == to)
+    {
+      continue;
+    }
+
+    glm::vec3 p[3] = { positions[corners[0]], positions[corners[1]], positions[corners[2]] };
+    glm::vec3 normalBefore = glm::cross(p[1] - p[0], p[2] - p[0]);
+    for (uint32_t k = 0; k < 3; ++k)
+    {
+      if (corners[k] == from)
+      {
+        p[k] = positions[to];
+      }
+    }
+    glm::vec3 normalAfter = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+    if (glm::dot(normalBefore, normalAfter) <= 0.0f)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void MeshSimplifier::applyCollapse(uint32_t from, uint32_t to)
+{
+  for (uint32_t triangle : vertexTriangles[from])
+  {
+    if (removed[triangle])
+    {
+      continue;
+    }
+
+    uint32_t* corners = &indices[triangle * 3];
+    if (corners[0] == to || corners[1] == to || corners[2] == to)
+    {
+      removed[triangle] = true;
+      --liveTriangleCount;
+      continue;
+    }
+
+    for (uint32_t k = 0; k < 3; ++k)
+    {
+      if (corners[k] == from)
+      {
+        corners[k] = to;
+      }
+    }
+    vertexTriangles[to].push_back(triangle);
+  }
+
+  vertexTriangles[from].clear();
+  quadrics[to].add(quadrics[from]);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Utilities.h"
+
+#include <vector>
+
+// Quadric error edge collapse for the LODs of a mesh. Vertices collapse onto one of their neighbours instead of
+// a new position, so every LOD only needs its own indices and shares the vertices of the full detail mesh.
+// Vertices on a border or a texture seam are never moved, the silhouette and UV charts stay intact.
+class MeshSimplifier
+{
+public:
+  // Indices must be a triangle list
+  MeshSimplifier(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+  // Collapse edges until at most targetIndexCount indices are left, or every collapse left is blocked.
+  // Can be called again with a smaller target, the simplification goes on from the current state.
+  void simplify(size_t targetIndexCount);
+
+  // Triangles left, in their original order
+  void getIndices(std::vector<uint32_t>& result) const;
+  size_t getIndexCount() const { return liveTriangleCount * 3; }
+
+  // Largest distance between the simplified surface and the original one, in model units
+  float getError() const { return error; }
+
+private:
+  // Sum of squared distances to the planes of the triangles around a vertex, weighted by their area
+  struct Quadric
+  {
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double c = 0.0;
+    double weight = 0.0;
+
+    void addPlane(const glm::vec3& normal, float distance, float planeWeight);
+    void add(const Quadric& other);
+    // Mean squared distance of a position to the planes
+    double evaluate(const glm::vec3& position) const;
+  };
+
+  struct Collapse
+  {
+    uint32_t from;
+    uint32_t to;
+    float cost;
+  };
+
+  std::vector<glm::vec3> positions;
+  std::vector<uint32_t> indices;
+  std::vector<bool> removed;                          // Triangles degenerated by a collapse
+  std::vector<std::vector<uint32_t>> vertexTriangles;
+  std::vector<Quadric> quadrics;
+  std::vector<bool> locked;
+  size_t liveTriangleCount;
+  float error;
+
+  bool isCollapseValid(uint32_t from, uint32_t to) const;
+  void applyCollapse(uint32_t from, uint32_t to);
+};
@@ -0,0 +1,86 @@
+#include "MipChain.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_CHAIN_SSE
+#include <emmintrin.h>
+#endif
+
+// Average of 2x2 texels of the source level for each texel of the destination level. The last row or column of
+// an odd sized level isn't sampled, and a level a single texel wide or high clamps and reuses its only column or row.
+static void downsample(const unsigned char* src, uint32_t srcWidth, uint32_t srcHeight,
+                       unsigned char* dst, uint32_t dstWidth, uint32_t dstHeight)
+{
+  for (uint32_t y = 0; y < dstHeight; ++y)
+  {
+    const unsigned char* row0 = src + static_cast<size_t>(std::min(2 * y, srcHeight - 1)) * srcWidth * 4;
+    const unsigned char* row1 = src + static_cast<size_t>(std::min(2 * y + 1, srcHeight - 1)) * srcWidth * 4;
+    unsigned char* dstRow = dst + static_cast<size_t>(y) * dstWidth * 4;
+
+    uint32_t x = 0;
+#if defined(MIP_CHAIN_SSE)
+    // 4 source texels of both rows give 2 destination texels, sums in 16 bits so the rounding is exact
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    for (; x + 2 <= dstWidth && 2 * x + 4 <= srcWidth; x += 2)
+    {
+      __m128i texels0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8 * x));
+      __m128i texels1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8 * x));
+
+      __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(texels0, zero), _mm_unpacklo_epi8(texels1, zero));
+      __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(texels0, zero), _mm_unpackhi_epi8(texels1, zero));
+      lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+      hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+
+      __m128i sum = _mm_unpacklo_epi64(lo, hi);
+      __m128i average = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(dstRow + 4 * x), _mm_packus_epi16(average, zero));
+    }
+#endif
+    for (; x < dstWidth; ++x)
+    {
+      uint32_t x0 = std::min(2 * x, srcWidth - 1);
+      uint32_t x1 = std::min(2 * x + 1, srcWidth - 1);
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        uint32_t sum = row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c];
+        dstRow[x * 4 + c] = static_cast<unsigned char>((sum + 2) >> 2);
+      }
+    }
+  }
+}
+
+uint32_t MipChain::LevelCount(uint32_t width, uint32_t height)
+{
+  uint32_t count = 1;
+  for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+  {
+    ++count;
+  }
+  return count;
+}
+
+void MipChain::build(const unsigned char* pixels, uint32_t width, uint32_t height)
+{
+  levels.resize(LevelCount(width, height));
+
+  size_t size = 0;
+  for (uint32_t i = 0; i < levels.size(); ++i)
+  {
+    levels[i].width = std::max(width >> i, 1u);
+    levels[i].height = std::max(height >> i, 1u);
+    levels[i].offset = size;
+    size += static_cast<size_t>(levels[i].width) * levels[i].height * 4;
+  }
+  data.resize(size);
+
+  memcpy(data.data(), pixels, static_cast<size_t>(width) * height * 4);
+  for (uint32_t i = 1; i < levels.size(); ++i)
+  {
+    const Level& src = levels[i - 1];
+    const Level& dst = levels[i];
+    downsample(data.data() + src.offset, src.width, src.height, data.data() + dst.offset, dst.width, dst.height);
+  }
+}
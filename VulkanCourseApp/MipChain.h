@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Full mip chain of an RGBA8 image, each level a 2x2 box filter of the one above down to 1x1.
+// Levels are packed one after the other, ready to be copied to a staging buffer and uploaded
+// with one buffer to image copy per level, which a transfer only queue can do (unlike blits).
+class MipChain
+{
+public:
+  struct Level
+  {
+    uint32_t width;
+    uint32_t height;
+    size_t offset;              // In bytes from the start of the chain
+  };
+
+  static uint32_t LevelCount(uint32_t width, uint32_t height);
+
+  // Level 0 is a copy of the pixels
+  void build(const unsigned char* pixels, uint32_t width, uint32_t height);
+
+  uint32_t getLevelCount() const { return static_cast<uint32_t>(levels.size()); }
+  const Level& getLevel(uint32_t index) const { assert(index < levels.size()); return levels[index]; }
+  const unsigned char* getData() const { return data.data(); }
+  size_t getSize() const { return data.size(); }
+
+private:
+  std::vector<Level> levels;
+  std::vector<unsigned char> data;
+};
@@ -0,0 +1,67 @@
+#include "RenderQueue.h"
+
+#include <cstring>
+
+uint64_t RenderQueue::MakeKey(uint32_t pipeline, uint32_t texture, uint32_t mesh, float depth)
+{
+  // Bits of a positive float sort in the same order as its value, keep the most significant ones
+  uint32_t depthBits = 0;
+  if (depth > 0.0f)
+  {
+    memcpy(&depthBits, &depth, sizeof(float));
+    depthBits >>= 32 - DEPTH_BITS;
+  }
+
+  uint64_t key = pipeline & ((1u << PIPELINE_BITS) - 1);
+  key = (key << TEXTURE_BITS) | (texture & ((1u << TEXTURE_BITS) - 1));
+  key = (key << MESH_BITS) | (mesh & ((1u << MESH_BITS) - 1));
+  key = (key << DEPTH_BITS) | depthBits;
+  return key;
+}
+
+void RenderQueue::sort()
+{
+  if (entries.size() < 2)
+  {
+    return;
+  }
+
+  sortBuffer.resize(entries.size());
+
+  // All the digit histograms in a single pass over the keys
+  uint32_t histograms[8][256] = {};
+  for (const auto& entry : entries)
+  {
+    for (uint32_t pass = 0; pass < 8; ++pass)
+    {
+      ++histograms[pass][(entry.key >> (pass * 8)) & 0xFF];
+    }
+  }
+
+  for (uint32_t pass = 0; pass < 8; ++pass)
+  {
+    uint32_t* histogram = histograms[pass];
+
+    // Every key has the same digit, this pass wouldn't change the order
+    uint32_t firstDigit = (entries[0].key >> (pass * 8)) & 0xFF;
+    if (histogram[firstDigit] == entries.size())
+    {
+      continue;
+    }
+
+    // Histogram to start offsets
+    uint32_t offset = 0;
+    for (uint32_t digit = 0; digit < 256; ++digit)
+    {
+      uint32_t count = histogram[digit];
+      histogram[digit] = offset;
+      offset += count;
+    }
+
+    for (const auto& entry : entries)
+    {
+      sortBuffer[histogram[(entry.key >> (pass * 8)) & 0xFF]++] = entry;
+    }
+    entries.swap(sortBuffer);
+  }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-frame list of draws ordered by a 64-bit state key, so draws sharing a pipeline, texture or mesh end up
+// next to each other: the command recording only has to bind what changes between two draws, and the
+// instances of a mesh can be drawn together.
+class RenderQueue
+{
+public:
+  // Key fields, from most to least significant
+  static const uint32_t PIPELINE_BITS = 4;
+  static const uint32_t TEXTURE_BITS = 16;
+  static const uint32_t MESH_BITS = 20;
+  static const uint32_t DEPTH_BITS = 24;
+
+  // Depth is the view distance, closer draws are sorted first to help early depth rejection.
+  // Mesh identifies the geometry bound, not the draw: a unique value per draw would make every key differ above
+  // the depth bits, so draws would neither be sorted by depth nor end up next to the other draws of their mesh.
+  static uint64_t MakeKey(uint32_t pipeline, uint32_t texture, uint32_t mesh, float depth);
+
+  void clear() { entries.clear(); }
+  void add(uint64_t key, uint32_t drawIndex) { entries.push_back({ key, drawIndex }); }
+
+  // Stable LSD radix sort on the keys, 8 bits per pass, passes where all keys have the same digit are skipped
+  void sort();
+
+  size_t size() const { return entries.size(); }
+  uint64_t getKey(size_t index) const { return entries[index].key; }
+  uint32_t getDrawIndex(size_t index) const { return entries[index].drawIndex; }
+
+private:
+  struct Entry
+  {
+    uint64_t key;
+    uint32_t drawIndex;
+  };
+
+  std::vector<Entry> entries;
+  std::vector<Entry> sortBuffer;
+};
@@ -0,0 +1,67 @@
+#include "SceneGraph.h"
+#include "TransformBatch.h"
+
+#include <algorithm>
+
+SceneGraph::SceneGraph()
+: hasDirtyNodes(false)
+{
+}
+
+uint32_t SceneGraph::addNode(int32_t parent, const glm::mat4& localTransform)
+{
+  uint32_t node = static_cast<uint32_t>(parents.size());
+  assert(parent < static_cast<int32_t>(node));
+  assert(parent < 0 || subtreeEnds[parent] == node);
+
+  parents.push_back(parent);
+  subtreeEnds.push_back(node + 1);
+  localTransforms.push_back(localTransform);
+  worldTransforms.push_back(localTransform);
+  dirty.push_back(1);
+  hasDirtyNodes = true;
+
+  // Node is the new end of its ancestors' subtrees
+  for (int32_t ancestor = parent; ancestor >= 0; ancestor = parents[ancestor])
+  {
+    subtreeEnds[ancestor] = node + 1;
+  }
+
+  return node;
+}
+
+void SceneGraph::setLocalTransform(uint32_t node, const glm::mat4& localTransform)
+{
+  assert(node < parents.size());
+  localTransforms[node] = localTransform;
+  dirty[node] = 1;
+  hasDirtyNodes = true;
+}
+
+void SceneGraph::update()
+{
+  if (!hasDirtyNodes)
+  {
+    return;
+  }
+
+  // Clean nodes are skipped one by one, a dirty node updates its whole subtree in order.
+  // Parents inside the subtree were updated just before their children, those outside of it didn't change.
+  uint32_t nodeCount = static_cast<uint32_t>(parents.size());
+  uint32_t node = 0;
+  while (node < nodeCount)
+  {
+    if (!dirty[node])
+    {
+      ++node;
+      continue;
+    }
+
+    uint32_t subtreeEnd = subtreeEnds[node];
+    TransformBatch::MultiplyHierarchy(parents.data(), localTransforms.data(), worldTransforms.data(), node, subtreeEnd);
+    std::fill(dirty.begin() + node, dirty.begin() + subtreeEnd, 0);
+    node = subtreeEnd;
+  }
+
+  hasDirtyNodes = false;
+}
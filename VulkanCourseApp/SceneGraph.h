@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// Transform hierarchy of every model in the scene, stored as flat arrays in topological order: a node always comes
+// after its parent, and the nodes of a subtree follow each other. World transforms are recomputed by a single pass
+// over the arrays, which only goes through the subtrees of the nodes changed since the previous one.
+class SceneGraph
+{
+public:
+  SceneGraph();
+
+  // Append a node under parent, -1 for a root. Nodes are added depth first: the parent's subtree must be the last one
+  // of the graph, so it stays contiguous. Returns the index of the node.
+  uint32_t addNode(int32_t parent, const glm::mat4& localTransform);
+
+  size_t getNodeCount() const { return parents.size(); }
+  int32_t getParent(uint32_t node) const { assert(node < parents.size()); return parents[node]; }
+
+  // World transforms of the node and its subtree are recomputed by the next update()
+  void setLocalTransform(uint32_t node, const glm::mat4& localTransform);
+  const glm::mat4& getLocalTransform(uint32_t node) const { assert(node < localTransforms.size()); return localTransforms[node]; }
+
+  void update();
+
+  // Valid after update()
+  const glm::mat4& getWorldTransform(uint32_t node) const { assert(node < worldTransforms.size()); return worldTransforms[node]; }
+
+private:
+  std::vector<int32_t> parents;
+  std::vector<uint32_t> subtreeEnds;          // One past the last node of the subtree
+  std::vector<glm::mat4> localTransforms;
+  std::vector<glm::mat4> worldTransforms;
+  std::vector<uint8_t> dirty;                 // Local transform changed since the last update
+  bool hasDirtyNodes;
+};
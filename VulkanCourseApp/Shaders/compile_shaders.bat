@@ -1,6 +1,9 @@
-C:/VulkanSDK/1.2.141.2/Bin32/glslangValidator.exe -DUSING_PUSH_CONSTANT -V shader.vert -o vertPushConstant.spv
-C:/VulkanSDK/1.2.141.2/Bin32/glslangValidator.exe -V shader.vert
+C:/VulkanSDK/1.2.141.2/Bin32/glslangValidator.exe -V shader.vert -o vertPushConstant.spv
+C:/VulkanSDK/1.2.141.2/Bin32/glslangValidator.exe -DUSING_OBJECT_BUFFER -V shader.vert -o vertInstanced.spv
 C:/VulkanSDK/1.2.141.2/Bin32/glslangValidator.exe -V shader.frag
+C:/VulkanSDK/1.2.141.2/Bin32/glslangValidator.exe -DUSING_TEXTURE_ARRAY -V shader.frag -o fragBindless.spv
 C:/VulkanSDK/1.2.141.2/Bin32/glslangValidator.exe -V second.vert -o second_vert.spv
 C:/VulkanSDK/1.2.141.2/Bin32/glslangValidator.exe -V second.frag -o second_frag.spv
+C:/VulkanSDK/1.2.141.2/Bin32/glslangValidator.exe -V cull.comp -o cull.spv
+C:/VulkanSDK/1.2.141.2/Bin32/glslangValidator.exe -V cluster_cull.comp -o cluster_cull.spv
 pause
\ No newline at end of file
@@ -1,14 +1,29 @@
 #version 450
 
+#if defined(USING_TEXTURE_ARRAY)
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
 layout(location = 0) in vec3 fragCol;
 layout(location = 1) in vec2 fragTexCoords;
 
 layout(location = 0) out vec4 outColour;
 
+#if defined(USING_TEXTURE_ARRAY)
+// Every texture, indexed with the texture index of the instance's object data
+layout(location = 2) flat in uint fragTexIndex;
+
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+#else
 layout(set = 1, binding = 0) uniform sampler2D Texture;
+#endif
 
 void main()
 {
+#if defined(USING_TEXTURE_ARRAY)
+	vec4 texColor = texture(textures[nonuniformEXT(fragTexIndex)], fragTexCoords);
+#else
 	vec4 texColor = texture(Texture, fragTexCoords);
+#endif
 	outColour = vec4(sqrt(mix(fragCol, texColor.rgb * texColor.rgb, 0.5)), texColor.a);
 }
\ No newline at end of file
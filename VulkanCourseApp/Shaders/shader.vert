@@ -10,11 +10,25 @@ layout(set = 0, binding = 0) uniform UboViewProjection
 	mat4 view;
 } uboViewProjection;
 
-#ifndef USING_PUSH_CONSTANT
-layout(set = 0, binding = 1) uniform UboModel
+#if defined(USING_OBJECT_BUFFER)
+struct ObjectData
 {
 	mat4 model;
-} uboModel;
+	vec4 positionScale;		// Packed positions are relative to the mesh bounds
+	vec4 positionBias;
+	uint textureIndex;
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer ObjectBuffer
+{
+	ObjectData objects[];
+} objectBuffer;
+
+// Object of each instance, the instances of a draw start at its firstInstance
+layout(std430, set = 0, binding = 3) readonly buffer InstanceBuffer
+{
+	uint instanceIndices[];
+} instanceBuffer;
 
 #else
 layout(push_constant) uniform PushModel
@@ -25,17 +39,31 @@ layout(push_constant) uniform PushModel
 
 layout(location = 0) out vec3 fragCol;
 layout(location = 1) out vec2 fragTexCoords;
+#if defined(USING_OBJECT_BUFFER)
+layout(location = 2) flat out uint fragTexIndex;
+#endif
 
 void main()
 {
+#if defined(USING_OBJECT_BUFFER)
+	ObjectData object = objectBuffer.objects[instanceBuffer.instanceIndices[gl_InstanceIndex]];
+#endif
+
 	gl_Position = uboViewProjection.projection * uboViewProjection.view *
-#ifndef USING_PUSH_CONSTANT
-				  uboModel.model *
+#if defined(USING_OBJECT_BUFFER)
+				  object.model *
 #else
 				  pushModel.model *
 #endif
+#if defined(USING_OBJECT_BUFFER)
+				  vec4(pos * object.positionScale.xyz + object.positionBias.xyz, 1.0);
+#else
 				  vec4(pos, 1.0);
+#endif
 
 	fragCol = col;
 	fragTexCoords = texCoords;
+#if defined(USING_OBJECT_BUFFER)
+	fragTexIndex = object.textureIndex;
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include "TextureCache.h"
+
+int TextureCache::acquire(const std::string& canonicalPath, uint64_t contentHash, uint64_t imageSize)
+{
+  auto it = entries.find(Key(canonicalPath, contentHash));
+  if (it == entries.end())
+  {
+    ++stats.misses;
+    return -1;
+  }
+
+  ++stats.hits;
+  stats.bytesSaved += imageSize;
+  ++it->second.refCount;
+  return it->second.slot;
+}
+
+void TextureCache::add(const std::string& canonicalPath, uint64_t contentHash, int slot)
+{
+  Key key(canonicalPath, contentHash);
+  entries[key] = { slot, 1 };
+  slotKeys[slot] = key;
+}
+
+bool TextureCache::release(int slot)
+{
+  auto keyIt = slotKeys.find(slot);
+  if (keyIt == slotKeys.end())
+  {
+    return false;
+  }
+
+  auto it = entries.find(keyIt->second);
+  if (--it->second.refCount > 0)
+  {
+    return false;
+  }
+
+  entries.erase(it);
+  slotKeys.erase(keyIt);
+  return true;
+}
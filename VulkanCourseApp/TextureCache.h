@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+// Textures already created, so the materials and models referencing the same image share one texture slot.
+// Entries are keyed by the canonical path of the file and the hash of its content, a file edited on disk
+// gets a texture of its own. Each reference is counted, the entry goes away with the last one and the
+// renderer destroys the texture of the slot.
+class TextureCache
+{
+public:
+  struct Stats
+  {
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint64_t bytesSaved = 0;        // Decoded image bytes not uploaded again thanks to hits
+  };
+
+  // Slot of the same texture with one more reference, -1 if it isn't in the cache
+  int acquire(const std::string& canonicalPath, uint64_t contentHash, uint64_t imageSize);
+
+  // Texture created after a miss, starts with one reference
+  void add(const std::string& canonicalPath, uint64_t contentHash, int slot);
+
+  // Returns true when it was the last reference of the slot
+  bool release(int slot);
+
+  size_t getTextureCount() const { return entries.size(); }
+  const Stats& getStats() const { return stats; }
+
+private:
+  typedef std::pair<std::string, uint64_t> Key;
+
+  struct Entry
+  {
+    int slot;
+    uint32_t refCount;
+  };
+
+  std::map<Key, Entry> entries;
+  std::map<int, Key> slotKeys;
+  Stats stats;
+};
@@ -0,0 +1,432 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+#include "MipChain.h"
+#include "stb_image.h"
+
+// Offsets in the staging buffer are kept aligned for optimal copy performance
+static const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+static VkFormat getVkFormat(BakedTexture::Format format)
+{
+  switch (format)
+  {
+    case BakedTexture::Format::BC1:
+      return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case BakedTexture::Format::BC3:
+      return VK_FORMAT_BC3_UNORM_BLOCK;
+    default:
+      return VK_FORMAT_R8G8B8A8_UNORM;
+  }
+}
+
+TextureStreamer::TextureStreamer()
+: device(VK_NULL_HANDLE)
+, allocator(nullptr)
+, transferQueue(VK_NULL_HANDLE)
+, transferFamily(0)
+, graphicsFamily(0)
+, m_pAllocCB(nullptr)
+, commandPool(VK_NULL_HANDLE)
+, nextGroup(0)
+, decodingCount(0)
+, stopping(false)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+}
+
+void TextureStreamer::init(VkDevice newDevice,
+                           DeviceAllocator& newAllocator,
+                           VkQueue newTransferQueue,
+                           uint32_t newTransferFamily,
+                           uint32_t newGraphicsFamily,
+                           uint32_t workerCount,
+                           VkAllocationCallbacks* a_pAllocCB)
+{
+  device = newDevice;
+  allocator = &newAllocator;
+  transferQueue = newTransferQueue;
+  transferFamily = newTransferFamily;
+  graphicsFamily = newGraphicsFamily;
+  m_pAllocCB = a_pAllocCB;
+
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = transferFamily;
+
+  if (vkCreateCommandPool(device, &poolInfo, m_pAllocCB, &commandPool) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create texture streaming command pool");
+  }
+
+  // stbi_load_from_memory only touches its arguments, the decodes of several files run at the same time
+  stopping = false;
+  for (uint32_t i = 0; i < std::max(workerCount, 1u); ++i)
+  {
+    workers.emplace_back(&TextureStreamer::workerLoop, this);
+  }
+}
+
+void TextureStreamer::destroy()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    requests.clear();
+  }
+  requestAvailable.notify_all();
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+  workers.clear();
+
+  groups.clear();
+  decoded.clear();
+
+  for (auto& upload : uploads)
+  {
+    vkWaitForFences(device, 1, &upload.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    destroyUpload(upload);
+  }
+  uploads.clear();
+
+  if (commandPool != VK_NULL_HANDLE)
+  {
+    vkDestroyCommandPool(device, commandPool, m_pAllocCB);
+    commandPool = VK_NULL_HANDLE;
+  }
+}
+
+void TextureStreamer::request(std::vector<Request> textures)
+{
+  if (textures.empty())
+  {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t group = nextGroup++;
+    groups[group].remaining = textures.size();
+    for (auto& texture : textures)
+    {
+      requests.emplace_back(group, std::move(texture));
+    }
+  }
+  requestAvailable.notify_all();
+}
+
+void TextureStreamer::update(std::vector<ResidentTexture>& resident)
+{
+  std::vector<DecodedTexture> textures;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    textures.swap(decoded);
+  }
+
+  if (!textures.empty())
+  {
+    submitUpload(textures);
+  }
+
+  // Uploads complete in submission order, stop at the first one still running
+  size_t completed = 0;
+  while (completed < uploads.size() && vkGetFenceStatus(device, uploads[completed].fence) == VK_SUCCESS)
+  {
+    finishUpload(uploads[completed], resident);
+    destroyUpload(uploads[completed]);
+    ++completed;
+  }
+  uploads.erase(uploads.begin(), uploads.begin() + completed);
+}
+
+size_t TextureStreamer::getPendingCount() const
+{
+  size_t uploadingCount = 0;
+  for (const auto& upload : uploads)
+  {
+    uploadingCount += upload.textures.size();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t groupedCount = 0;
+  for (const auto& group : groups)
+  {
+    groupedCount += group.second.textures.size();
+  }
+  return requests.size() + decodingCount + groupedCount + decoded.size() + uploadingCount;
+}
+
+void TextureStreamer::workerLoop()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true)
+  {
+    requestAvailable.wait(lock, [this] { return stopping || !requests.empty(); });
+    if (stopping)
+    {
+      return;
+    }
+
+    uint32_t groupId = requests.front().first;
+    Request request = std::move(requests.front().second);
+    requests.pop_front();
+    ++decodingCount;
+    lock.unlock();
+
+    // Decoding and filtering are the slow part, done without holding the lock
+    DecodedTexture texture = { request.slot };
+    bool loaded = false;
+    if (BakedTexture::IsBaked(request.fileData.data(), request.fileData.size()))
+    {
+      loaded = texture.image.load(request.fileData.data(), request.fileData.size());
+    }
+    else
+    {
+      int width = 0, height = 0, channels = 0;
+      stbi_uc* pixels = stbi_load_from_memory(request.fileData.data(), static_cast<int>(request.fileData.size()),
+                                              &width, &height, &channels, STBI_rgb_alpha);
+      if (pixels)
+      {
+        MipChain mips;
+        mips.build(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+        stbi_image_free(pixels);
+
+        texture.image.build(mips, BakedTexture::Format::RGBA8);
+        loaded = true;
+      }
+    }
+
+    lock.lock();
+    --decodingCount;
+
+    Group& group = groups[groupId];
+    if (loaded)
+    {
+      group.textures.push_back(std::move(texture));
+    }
+    else
+    {
+      // Draws keep the placeholder
+      printf("Warning: failed to load texture file %s\n", request.filename.c_str());
+    }
+
+    // Last texture of the group, it goes to the next upload with the others
+    if (--group.remaining == 0)
+    {
+      decoded.insert(decoded.end(), std::make_move_iterator(group.textures.begin()),
+                     std::make_move_iterator(group.textures.end()));
+      groups.erase(groupId);
+    }
+  }
+}
+
+void TextureStreamer::submitUpload(std::vector<DecodedTexture>& textures)
+{
+  Upload upload = {};
+
+  // One staging buffer and one command buffer for every texture decoded since the last update
+  std::vector<VkDeviceSize> stagingOffsets(textures.size());
+  VkDeviceSize stagingSize = 0;
+  for (size_t i = 0; i < textures.size(); ++i)
+  {
+    stagingOffsets[i] = (stagingSize + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+    stagingSize = stagingOffsets[i] + textures[i].image.getSize();
+  }
+
+  createBuffer(device,
+               *allocator,
+               stagingSize,
+               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               &upload.stagingBuffer,
+               &upload.stagingBufferMemory,
+               m_pAllocCB,
+               AllocationStrategy::Linear);
+
+  // Images are read by the graphics queue once resident, without transferring their ownership
+  uint32_t queueFamilies[] = { transferFamily, graphicsFamily };
+
+  for (size_t i = 0; i < textures.size(); ++i)
+  {
+    const BakedTexture& image = textures[i].image;
+    const BakedTexture::Level& baseLevel = image.getLevel(0);
+
+    memcpy(static_cast<char*>(upload.stagingBufferMemory.mappedData) + stagingOffsets[i], image.getData(), image.getSize());
+
+    VkImageCreateInfo imageCreateInfo = {};
+    imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.extent.width = baseLevel.width;
+    imageCreateInfo.extent.height = baseLevel.height;
+    imageCreateInfo.extent.depth = 1;
+    imageCreateInfo.mipLevels = image.getLevelCount();
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.format = getVkFormat(image.getFormat());
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    if (transferFamily != graphicsFamily)
+    {
+      imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+      imageCreateInfo.queueFamilyIndexCount = 2;
+      imageCreateInfo.pQueueFamilyIndices = queueFamilies;
+    }
+    else
+    {
+      imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    }
+
+    ResidentTexture resident = {};
+    resident.slot = textures[i].slot;
+    if (vkCreateImage(device, &imageCreateInfo, m_pAllocCB, &resident.image) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create image");
+    }
+    resident.memory = allocator->allocateImage(resident.image, VK_IMAGE_TILING_OPTIMAL, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VkImageViewCreateInfo viewCreateInfo = {};
+    viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewCreateInfo.image = resident.image;
+    viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewCreateInfo.format = imageCreateInfo.format;
+    viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewCreateInfo.subresourceRange.baseMipLevel = 0;
+    viewCreateInfo.subresourceRange.levelCount = image.getLevelCount();
+    viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+    viewCreateInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(device, &viewCreateInfo, m_pAllocCB, &resident.imageView) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Unable to create the image view");
+    }
+
+    upload.textures.push_back(resident);
+  }
+
+  VkCommandBufferAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = commandPool;
+  allocInfo.commandBufferCount = 1;
+  vkAllocateCommandBuffers(device, &allocInfo, &upload.commandBuffer);
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(upload.commandBuffer, &beginInfo);
+
+  std::vector<VkImageMemoryBarrier> barriers(upload.textures.size());
+  for (size_t i = 0; i < barriers.size(); ++i)
+  {
+    VkImageMemoryBarrier& barrier = barriers[i];
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = upload.textures[i].image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = textures[i].image.getLevelCount();
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+  }
+  vkCmdPipelineBarrier(upload.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                       0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+  // One region per mip level, all levels of a texture in one copy
+  std::vector<VkBufferImageCopy> regions;
+  for (size_t i = 0; i < textures.size(); ++i)
+  {
+    const BakedTexture& image = textures[i].image;
+    regions.resize(image.getLevelCount());
+    for (uint32_t level = 0; level < image.getLevelCount(); ++level)
+    {
+      VkBufferImageCopy& region = regions[level];
+      region = {};
+      region.bufferOffset = stagingOffsets[i] + image.getLevel(level).offset;
+      region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      region.imageSubresource.mipLevel = level;
+      region.imageSubresource.baseArrayLayer = 0;
+      region.imageSubresource.layerCount = 1;
+      region.imageOffset = { 0, 0, 0 };
+      region.imageExtent = { image.getLevel(level).width, image.getLevel(level).height, 1 };
+    }
+
+    vkCmdCopyBufferToImage(upload.commandBuffer, upload.stagingBuffer, upload.textures[i].image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+  }
+
+  // A transfer only queue has no fragment stage, the fence wait on the host orders the reads on the graphics queue
+  bool sameQueueFamily = transferFamily == graphicsFamily;
+  for (auto& barrier : barriers)
+  {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = sameQueueFamily ? VK_ACCESS_SHADER_READ_BIT : 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  }
+  vkCmdPipelineBarrier(upload.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       sameQueueFamily ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                       0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+  vkEndCommandBuffer(upload.commandBuffer);
+
+  VkFenceCreateInfo fenceCreateInfo = {};
+  fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  if (vkCreateFence(device, &fenceCreateInfo, m_pAllocCB, &upload.fence) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create texture upload fence");
+  }
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &upload.commandBuffer;
+
+  if (vkQueueSubmit(transferQueue, 1, &submitInfo, upload.fence) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to submit texture upload");
+  }
+
+  uploads.push_back(upload);
+}
+
+void TextureStreamer::finishUpload(Upload& upload, std::vector<ResidentTexture>& resident)
+{
+  resident.insert(resident.end(), upload.textures.begin(), upload.textures.end());
+  upload.textures.clear();
+}
+
+void TextureStreamer::destroyUpload(Upload& upload)
+{
+  // Textures still here were never handed over
+  for (auto& texture : upload.textures)
+  {
+    vkDestroyImageView(device, texture.imageView, m_pAllocCB);
+    vkDestroyImage(device, texture.image, m_pAllocCB);
+    allocator->free(texture.memory);
+  }
+  upload.textures.clear();
+
+  vkFreeCommandBuffers(device, commandPool, 1, &upload.commandBuffer);
+  vkDestroyFence(device, upload.fence, m_pAllocCB);
+  vkDestroyBuffer(device, upload.stagingBuffer, m_pAllocCB);
+  allocator->free(upload.stagingBufferMemory);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BakedTexture.h"
+#include "Utilities.h"
+
+// Loads textures without stalling the frame loop: image files are decoded and their mip chain built in parallel on
+// worker threads, and the decoded images are uploaded on the transfer queue. Textures baked by the AssetBaker are
+// uploaded as they are. The renderer polls once per frame for the textures whose
+// upload completed, draws keep using a placeholder until then.
+class TextureStreamer
+{
+public:
+  struct Request
+  {
+    uint32_t slot;                // Identifies the texture once resident
+    std::string filename;         // For messages
+    std::vector<unsigned char> fileData;    // Content of the image or baked texture file
+  };
+
+  // Texture whose upload completed, owned by the renderer from then on
+  struct ResidentTexture
+  {
+    uint32_t slot;
+    VkImage image;
+    DeviceAllocation memory;
+    VkImageView imageView;
+  };
+
+  TextureStreamer();
+  ~TextureStreamer();
+
+  // Images are shared with the graphics family when the transfer queue is in another family
+  void init(VkDevice newDevice,
+            DeviceAllocator& newAllocator,
+            VkQueue newTransferQueue,
+            uint32_t newTransferFamily,
+            uint32_t newGraphicsFamily,
+            uint32_t workerCount,
+            VkAllocationCallbacks* a_pAllocCB = nullptr);
+
+  // Stops the workers and waits for the uploads in flight, textures that aren't resident yet are dropped
+  void destroy();
+
+  // Queue textures to decode, e.g. the materials of a model. They are decoded in parallel, and uploaded
+  // in the same submission once all of them are decoded.
+  void request(std::vector<Request> textures);
+
+  // Submit the groups of textures decoded since the last call in one upload, and append those whose upload completed.
+  // Never waits on the device, must be called from the thread owning the transfer queue.
+  void update(std::vector<ResidentTexture>& resident);
+
+  // Textures requested but not resident yet
+  size_t getPendingCount() const;
+
+private:
+  struct DecodedTexture
+  {
+    uint32_t slot;
+    BakedTexture image;
+  };
+
+  struct Upload
+  {
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    VkBuffer stagingBuffer;
+    DeviceAllocation stagingBufferMemory;
+    std::vector<ResidentTexture> textures;
+  };
+
+  VkDevice device;
+  DeviceAllocator* allocator;
+  VkQueue transferQueue;
+  uint32_t transferFamily;
+  uint32_t graphicsFamily;
+  VkAllocationCallbacks* m_pAllocCB;
+  VkCommandPool commandPool;
+
+  // Textures of one request call, held back until the last of them is decoded
+  struct Group
+  {
+    size_t remaining;
+    std::vector<DecodedTexture> textures;
+  };
+
+  // Shared with the worker threads
+  mutable std::mutex mutex;
+  std::condition_variable requestAvailable;
+  std::deque<std::pair<uint32_t, Request>> requests;     // Group id and request
+  std::map<uint32_t, Group> groups;
+  uint32_t nextGroup;
+  std::vector<DecodedTexture> decoded;
+  size_t decodingCount;
+  bool stopping;
+  std::vector<std::thread> workers;
+
+  std::vector<Upload> uploads;
+
+  void workerLoop();
+  void submitUpload(std::vector<DecodedTexture>& textures);
+  void finishUpload(Upload& upload, std::vector<ResidentTexture>& resident);
+  void destroyUpload(Upload& upload);
+};
@@ -0,0 +1,151 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(uint32_t workerCount)
+: job(nullptr)
+, jobTaskCount(0)
+, nextTask(0)
+, tasksRemaining(0)
+, activeWorkers(0)
+, generation(0)
+, stopping(false)
+{
+  workers.reserve(workerCount);
+  for (uint32_t i = 0; i < workerCount; ++i)
+  {
+    workers.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  workAvailable.notify_all();
+
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+}
+
+uint32_t ThreadPool::DefaultWorkerCount()
+{
+  uint32_t coreCount = std::thread::hardware_concurrency();
+  return coreCount > 1 ? coreCount - 1 : 0;
+}
+
+void ThreadPool::parallelFor(uint32_t taskCount, const std::function<void(uint32_t)>& task)
+{
+  if (taskCount == 0)
+  {
+    return;
+  }
+
+  if (taskCount == 1 || workers.empty())
+  {
+    for (uint32_t i = 0; i < taskCount; ++i)
+    {
+      task(i);
+    }
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // A worker waking up late from the previous job could still be looking at its counters
+    workDone.wait(lock, [this] { return activeWorkers == 0; });
+
+    job = &task;
+    jobTaskCount = taskCount;
+    nextTask = 0;
+    tasksRemaining = taskCount;
+    error = nullptr;
+    ++generation;
+  }
+  workAvailable.notify_all();
+
+  runTasks(task, taskCount);
+
+  std::exception_ptr jobError;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    workDone.wait(lock, [this] { return tasksRemaining == 0 && activeWorkers == 0; });
+    job = nullptr;
+    jobError = error;
+  }
+
+  if (jobError)
+  {
+    std::rethrow_exception(jobError);
+  }
+}
+
+void ThreadPool::workerLoop()
+{
+  uint64_t lastGeneration = 0;
+
+  while (true)
+  {
+    const std::function<void(uint32_t)>* task = nullptr;
+    uint32_t taskCount = 0;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      workAvailable.wait(lock, [&] { return stopping || (generation != lastGeneration && job != nullptr); });
+      if (stopping)
+      {
+        return;
+      }
+
+      lastGeneration = generation;
+      task = job;
+      taskCount = jobTaskCount;
+      ++activeWorkers;
+    }
+
+    runTasks(*task, taskCount);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      --activeWorkers;
+    }
+    workDone.notify_all();
+  }
+}
+
+void ThreadPool::runTasks(const std::function<void(uint32_t)>& task, uint32_t taskCount)
+{
+  while (true)
+  {
+    uint32_t taskIndex = nextTask++;
+    if (taskIndex >= taskCount)
+    {
+      return;
+    }
+
+    try
+    {
+      task(taskIndex);
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error)
+      {
+        error = std::current_exception();
+      }
+    }
+
+    bool lastTask = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      lastTask = --tasksRemaining == 0;
+    }
+    if (lastTask)
+    {
+      workDone.notify_all();
+    }
+  }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running the tasks of one parallelFor at a time.
+// The calling thread takes part in the work, so there are getThreadCount() tasks running at most.
+class ThreadPool
+{
+public:
+  // Default is one thread per core, including the calling thread
+  explicit ThreadPool(uint32_t workerCount = DefaultWorkerCount());
+  ~ThreadPool();
+
+  uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+  // Call task(taskIndex) for every index in [0, taskCount) and return once all of them are done.
+  // The first exception thrown by a task is rethrown here.
+  void parallelFor(uint32_t taskCount, const std::function<void(uint32_t)>& task);
+
+  static uint32_t DefaultWorkerCount();
+
+private:
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable workAvailable;
+  std::condition_variable workDone;
+
+  const std::function<void(uint32_t)>* job;
+  uint32_t jobTaskCount;
+  std::atomic<uint32_t> nextTask;
+  uint32_t tasksRemaining;
+  uint32_t activeWorkers;
+  uint64_t generation;
+  bool stopping;
+  std::exception_ptr error;
+
+  void workerLoop();
+  void runTasks(const std::function<void(uint32_t)>& task, uint32_t taskCount);
+};
@@ -0,0 +1,124 @@
+#include "TransformBatch.h"
+
+#include "CpuFeatures.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_BATCH_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM) || defined(_M_ARM64)
+#define TRANSFORM_BATCH_NEON
+#include <arm_neon.h>
+#endif
+
+// Column j of the result is the sum of the columns of a weighted by the components of column j of b.
+// Every input is loaded before the result is stored, so it can overwrite them.
+static inline void multiplyMatrix(const glm::mat4& a, const glm::mat4& b, glm::mat4& result)
+{
+#if defined(TRANSFORM_BATCH_SSE)
+  const float* pa = &a[0][0];
+  const float* pb = &b[0][0];
+
+  __m128 a0 = _mm_loadu_ps(pa);
+  __m128 a1 = _mm_loadu_ps(pa + 4);
+  __m128 a2 = _mm_loadu_ps(pa + 8);
+  __m128 a3 = _mm_loadu_ps(pa + 12);
+
+  __m128 r[4];
+  for (int j = 0; j < 4; ++j)
+  {
+    __m128 bj = _mm_loadu_ps(pb + j * 4);
+    r[j] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_shuffle_ps(bj, bj, 0x00)), _mm_mul_ps(a1, _mm_shuffle_ps(bj, bj, 0x55))),
+                      _mm_add_ps(_mm_mul_ps(a2, _mm_shuffle_ps(bj, bj, 0xAA)), _mm_mul_ps(a3, _mm_shuffle_ps(bj, bj, 0xFF))));
+  }
+
+  float* pr = &result[0][0];
+  for (int j = 0; j < 4; ++j)
+  {
+    _mm_storeu_ps(pr + j * 4, r[j]);
+  }
+#elif defined(TRANSFORM_BATCH_NEON)
+  const float* pa = &a[0][0];
+  const float* pb = &b[0][0];
+
+  float32x4_t a0 = vld1q_f32(pa);
+  float32x4_t a1 = vld1q_f32(pa + 4);
+  float32x4_t a2 = vld1q_f32(pa + 8);
+  float32x4_t a3 = vld1q_f32(pa + 12);
+
+  float32x4_t r[4];
+  for (int j = 0; j < 4; ++j)
+  {
+    float32x4_t bj = vld1q_f32(pb + j * 4);
+    r[j] = vmulq_lane_f32(a0, vget_low_f32(bj), 0);
+    r[j] = vmlaq_lane_f32(r[j], a1, vget_low_f32(bj), 1);
+    r[j] = vmlaq_lane_f32(r[j], a2, vget_high_f32(bj), 0);
+    r[j] = vmlaq_lane_f32(r[j], a3, vget_high_f32(bj), 1);
+  }
+
+  float* pr = &result[0][0];
+  for (int j = 0; j < 4; ++j)
+  {
+    vst1q_f32(pr + j * 4, r[j]);
+  }
+#else
+  result = a * b;
+#endif
+}
+
+void TransformBatch::Multiply(const glm::mat4* a, const glm::mat4* b, glm::mat4* result, size_t count)
+{
+#if defined(CPU_FEATURES_X86)
+  if (CpuFeatures::HasAvx2())
+  {
+    MultiplyAvx2(a, b, result, count);
+    return;
+  }
+#endif
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    multiplyMatrix(a[i], b[i], result[i]);
+  }
+}
+
+void TransformBatch::MultiplyHierarchy(const int32_t* parents, const glm::mat4* locals, glm::mat4* worlds, size_t first, size_t end)
+{
+#if defined(CPU_FEATURES_X86)
+  if (CpuFeatures::HasAvx2())
+  {
+    MultiplyHierarchyAvx2(parents, locals, worlds, first, end);
+    return;
+  }
+#endif
+
+  for (size_t i = first; i < end; ++i)
+  {
+    int32_t parent = parents[i];
+    if (parent < 0)
+    {
+      worlds[i] = locals[i];
+    }
+    else
+    {
+      multiplyMatrix(worlds[parent], locals[i], worlds[i]);
+    }
+  }
+}
+
+const char* TransformBatch::GetInstructionSet()
+{
+#if defined(CPU_FEATURES_X86)
+  if (CpuFeatures::HasAvx2())
+  {
+    return "AVX2";
+  }
+#endif
+
+#if defined(TRANSFORM_BATCH_SSE)
+  return "SSE";
+#elif defined(TRANSFORM_BATCH_NEON)
+  return "NEON";
+#else
+  return "glm";
+#endif
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+// 4x4 matrix products of the scene graph transform pass. Each product is done on full registers: two result columns
+// per instruction with AVX2, one with SSE or NEON, glm otherwise. AVX2 is picked at run time on x86, the others at
+// compile time. Results match glm's operator* up to rounding.
+class TransformBatch
+{
+public:
+  // result[i] = a[i] * b[i], result may be a or b
+  static void Multiply(const glm::mat4* a, const glm::mat4* b, glm::mat4* result, size_t count);
+
+  // worlds[i] = worlds[parents[i]] * locals[i] for the nodes from first to end in order, locals[i] for the roots.
+  // A parent must come before its children, or be outside of the range and up to date.
+  static void MultiplyHierarchy(const int32_t* parents, const glm::mat4* locals, glm::mat4* worlds, size_t first, size_t end);
+
+  // Instruction set of the products on this CPU
+  static const char* GetInstructionSet();
+
+private:
+  // TransformBatchAvx2.cpp, only called when the CPU has AVX2
+  static void MultiplyAvx2(const glm::mat4* a, const glm::mat4* b, glm::mat4* result, size_t count);
+  static void MultiplyHierarchyAvx2(const int32_t* parents, const glm::mat4* locals, glm::mat4* worlds, size_t first, size_t end);
+};
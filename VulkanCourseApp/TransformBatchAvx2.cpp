@@ -0,0 +1,67 @@
+#include "TransformBatch.h"
+
+#include "CpuFeatures.h"
+
+#if defined(CPU_FEATURES_X86)
+#include <immintrin.h>
+
+// The projects build this file with /arch:AVX2, GCC and Clang get the target per function
+#if defined(__GNUC__) && !defined(__AVX2__)
+#define TRANSFORM_BATCH_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define TRANSFORM_BATCH_AVX2_TARGET
+#endif
+
+// Same product as multiplyMatrix in TransformBatch.cpp, two result columns per instruction
+TRANSFORM_BATCH_AVX2_TARGET static inline void multiplyMatrixAvx2(const glm::mat4& a, const glm::mat4& b, glm::mat4& result)
+{
+  const float* pa = &a[0][0];
+  const float* pb = &b[0][0];
+
+  // Columns of a in both halves, columns 0 and 1 then 2 and 3 of b and of the result
+  __m256 a0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pa));
+  __m256 a1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pa + 4));
+  __m256 a2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pa + 8));
+  __m256 a3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(pa + 12));
+  __m256 b01 = _mm256_loadu_ps(pb);
+  __m256 b23 = _mm256_loadu_ps(pb + 8);
+
+  __m256 r01 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a0, _mm256_permute_ps(b01, 0x00)),
+                                           _mm256_mul_ps(a1, _mm256_permute_ps(b01, 0x55))),
+                             _mm256_add_ps(_mm256_mul_ps(a2, _mm256_permute_ps(b01, 0xAA)),
+                                           _mm256_mul_ps(a3, _mm256_permute_ps(b01, 0xFF))));
+  __m256 r23 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a0, _mm256_permute_ps(b23, 0x00)),
+                                           _mm256_mul_ps(a1, _mm256_permute_ps(b23, 0x55))),
+                             _mm256_add_ps(_mm256_mul_ps(a2, _mm256_permute_ps(b23, 0xAA)),
+                                           _mm256_mul_ps(a3, _mm256_permute_ps(b23, 0xFF))));
+
+  float* pr = &result[0][0];
+  _mm256_storeu_ps(pr, r01);
+  _mm256_storeu_ps(pr + 8, r23);
+}
+
+TRANSFORM_BATCH_AVX2_TARGET void TransformBatch::MultiplyAvx2(const glm::mat4* a, const glm::mat4* b, glm::mat4* result, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    multiplyMatrixAvx2(a[i], b[i], result[i]);
+  }
+}
+
+TRANSFORM_BATCH_AVX2_TARGET void TransformBatch::MultiplyHierarchyAvx2(const int32_t* parents, const glm::mat4* locals, glm::mat4* worlds,
+                                                                       size_t first, size_t end)
+{
+  for (size_t i = first; i < end; ++i)
+  {
+    int32_t parent = parents[i];
+    if (parent < 0)
+    {
+      worlds[i] = locals[i];
+    }
+    else
+    {
+      multiplyMatrixAvx2(worlds[parent], locals[i], worlds[i]);
+    }
+  }
+}
+#endif
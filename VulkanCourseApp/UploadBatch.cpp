@@ -0,0 +1,174 @@
+#include "UploadBatch.h"
+
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+// Offsets in the staging buffer are kept aligned for optimal copy performance
+static const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+UploadBatch::UploadBatch(VkDevice newDevice,
+                         DeviceAllocator& newAllocator,
+                         VkQueue newTransferQueue,
+                         VkCommandPool newTransferCmdPool,
+                         VkDeviceSize newStagingSize,
+                         VkAllocationCallbacks* a_pAllocCB)
+: device(newDevice)
+, allocator(&newAllocator)
+, transferQueue(newTransferQueue)
+, transferCmdPool(newTransferCmdPool)
+, m_pAllocCB(a_pAllocCB)
+, stagingBuffer(VK_NULL_HANDLE)
+, stagingSize(0)
+, stagingOffset(0)
+, stagingData(nullptr)
+, commandBuffer(VK_NULL_HANDLE)
+, fence(VK_NULL_HANDLE)
+{
+  VkFenceCreateInfo fenceCreateInfo = {};
+  fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  if (vkCreateFence(device, &fenceCreateInfo, m_pAllocCB, &fence) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create upload fence");
+  }
+
+  if (newStagingSize > 0)
+  {
+    createStagingBuffer(newStagingSize);
+  }
+}
+
+UploadBatch::~UploadBatch()
+{
+  // Uploads recorded after the last submit() are dropped
+  assert(commandBuffer == VK_NULL_HANDLE);
+  if (commandBuffer != VK_NULL_HANDLE)
+  {
+    vkEndCommandBuffer(commandBuffer);
+    vkFreeCommandBuffers(device, transferCmdPool, 1, &commandBuffer);
+  }
+
+  destroyStagingBuffer();
+  vkDestroyFence(device, fence, m_pAllocCB);
+}
+
+void UploadBatch::uploadBuffer(VkBuffer dstBuffer, const void* srcData, VkDeviceSize size, VkDeviceSize dstOffset)
+{
+  if (size == 0)
+  {
+    return;
+  }
+
+  VkDeviceSize srcOffset = (stagingOffset + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+  if (srcOffset + size > stagingSize)
+  {
+    // Flush what was recorded so far to reuse the staging buffer from the start
+    submit();
+    srcOffset = 0;
+
+    if (size > stagingSize)
+    {
+      destroyStagingBuffer();
+      createStagingBuffer(size);
+    }
+  }
+
+  memcpy(stagingData + srcOffset, srcData, static_cast<size_t>(size));
+  stagingOffset = srcOffset + size;
+
+  if (commandBuffer == VK_NULL_HANDLE)
+  {
+    commandBuffer = beginCommandBuffer(device, transferCmdPool);
+  }
+
+  VkBufferCopy region = {};
+  region.srcOffset = srcOffset;
+  region.dstOffset = dstOffset;
+  region.size = size;
+  vkCmdCopyBuffer(commandBuffer, stagingBuffer, dstBuffer, 1, &region);
+}
+
+void UploadBatch::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+{
+  if (size == 0)
+  {
+    return;
+  }
+
+  if (commandBuffer == VK_NULL_HANDLE)
+  {
+    commandBuffer = beginCommandBuffer(device, transferCmdPool);
+  }
+  else
+  {
+    // Source may have been written by a copy recorded earlier in this batch
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
+  }
+
+  VkBufferCopy region = {};
+  region.size = size;
+  vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &region);
+}
+
+void UploadBatch::submit()
+{
+  if (commandBuffer == VK_NULL_HANDLE)
+  {
+    return;
+  }
+
+  vkEndCommandBuffer(commandBuffer);
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+  if (vkQueueSubmit(transferQueue, 1, &submitInfo, fence) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to submit upload batch");
+  }
+
+  // Only wait for this batch, not for everything else running on the queue
+  vkWaitForFences(device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+  vkResetFences(device, 1, &fence);
+
+  vkFreeCommandBuffers(device, transferCmdPool, 1, &commandBuffer);
+  commandBuffer = VK_NULL_HANDLE;
+  stagingOffset = 0;
+}
+
+void UploadBatch::createStagingBuffer(VkDeviceSize size)
+{
+  createBuffer(device,
+               *allocator,
+               size,
+               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+               &stagingBuffer,
+               &stagingBufferMemory,
+               m_pAllocCB,
+               AllocationStrategy::Linear);
+
+  // Host visible memory is persistently mapped by the allocator
+  stagingData = static_cast<char*>(stagingBufferMemory.mappedData);
+  stagingSize = size;
+  stagingOffset = 0;
+}
+
+void UploadBatch::destroyStagingBuffer()
+{
+  if (stagingBuffer != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(device, stagingBuffer, m_pAllocCB);
+    allocator->free(stagingBufferMemory);
+    stagingBuffer = VK_NULL_HANDLE;
+    stagingData = nullptr;
+    stagingSize = 0;
+  }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "Utilities.h"
+
+// Groups uploads to device local buffers: data is copied in one staging buffer and the transfers are
+// recorded in one command buffer, submitted once and waited on with a single fence.
+class UploadBatch
+{
+public:
+  UploadBatch(VkDevice newDevice,
+              DeviceAllocator& newAllocator,
+              VkQueue newTransferQueue,
+              VkCommandPool newTransferCmdPool,
+              VkDeviceSize newStagingSize,
+              VkAllocationCallbacks* a_pAllocCB = nullptr);
+  ~UploadBatch();
+
+  // Copy data in the staging buffer and record its transfer to dstBuffer.
+  // If the staging buffer is full, the uploads recorded so far are submitted first.
+  void uploadBuffer(VkBuffer dstBuffer, const void* srcData, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+
+  // Record a device side copy between two buffers, ordered after the uploads recorded before it
+  void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+
+  // Submit all recorded uploads and wait for them to complete, must be called before destroying the batch
+  void submit();
+
+private:
+  VkDevice device;
+  DeviceAllocator* allocator;
+  VkQueue transferQueue;
+  VkCommandPool transferCmdPool;
+  VkAllocationCallbacks* m_pAllocCB;
+
+  VkBuffer stagingBuffer;
+  DeviceAllocation stagingBufferMemory;
+  VkDeviceSize stagingSize;
+  VkDeviceSize stagingOffset;
+  char* stagingData;
+
+  VkCommandBuffer commandBuffer;
+  VkFence fence;
+
+  void createStagingBuffer(VkDeviceSize size);
+  void destroyStagingBuffer();
+};
@@ -7,8 +7,13 @@
 #include <glm/glm.hpp>
 #include <vector>
 
+#include "DeviceAllocator.h"
+
 const int MAX_FRAME_DRAWS = 2;
-const int MAX_OBJECTS = 20;
+const int MAX_BINDLESS_TEXTURES = 4096;
+const int MAX_MESH_LODS = 5;
+const int MAX_MESHLET_VERTICES = 64;
+const int MAX_MESHLET_TRIANGLES = 124;
 
 const std::vector<const char*> deviceExtensions
 {
@@ -23,11 +28,63 @@ struct Vertex
   glm::vec2 tex;      // Vertex texture coordinates (u, v)
 };
 
+// Compact vertex: position normalized to the bounding box of its mesh, RGBA8 color and half float texture
+// coordinates. Half the size of Vertex, the vertex transform of the mesh maps the position back to model space.
+struct PackedVertex
+{
+  uint64_t pos;       // UNORM16 x, y, z, w unused
+  uint32_t col;       // UNORM8 r, g, b, a
+  uint32_t tex;       // SFLOAT16 u, v
+};
+
+enum class VertexFormat
+{
+  Float,              // Vertex
+  Packed,             // PackedVertex
+};
+
+// Bounding sphere of a mesh, in model space
+struct BoundingSphere
+{
+  glm::vec3 center;
+  float radius;
+};
+
+// Level of detail of a mesh, a range of its indices drawn with the same vertices
+struct MeshLod
+{
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  float error;            // Distance to the full detail surface, in model units
+};
+
+// Cluster of full detail triangles culled as a whole, std430 layout of the cluster culling shader
+struct Meshlet
+{
+  glm::vec4 sphere;       // Model space center and radius
+  glm::vec4 cone;         // Axis of the triangle normals, and the cutoff: every triangle faces away from a viewer
+                          // when dot(center - eye, axis) >= cutoff * length(center - eye) + radius
+  uint32_t firstIndex;    // Relative to the mesh indices, in the arena index buffer once uploaded
+  uint32_t indexCount;
+  uint32_t padding[2];
+};
+
+// Node of a model's transform hierarchy. Nodes are stored parents first, and the nodes of a subtree follow each other.
+struct MeshNode
+{
+  glm::mat4 transform;    // Relative to the parent node
+  int32_t parent;         // -1 for the root
+  uint32_t firstMesh;     // Meshes drawn with the node's transform, in the node mesh list of the model
+  uint32_t meshCount;
+  uint32_t padding;
+};
+
 // Indices (locations of Queue Families (if they exist at all)
 struct QueueFamilyIndices
 {
   int graphicsFamily = -1;         // Location of Graphics Queue Family
   int presentationFamily = -1;     // Location of Presentation Queue Family
+  int transferFamily = -1;         // Queue Family of texture uploads, a transfer only one if there is any
 
   // Check if queue families are valid
   bool isValid()
@@ -70,31 +127,30 @@ static std::vector<char> readFile(const std::string& filename)
   return fileBuffer;
 }
 
-static uint32_t findMemoryTypeIndex(VkPhysicalDevice physicalDevice, uint32_t allowedTypes, VkMemoryPropertyFlags properties)
-{
-  VkPhysicalDeviceMemoryProperties memProperties;
-  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+static const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+static const uint64_t FNV_PRIME = 1099511628211ull;
 
-  for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i)
+static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+{
+  // FNV-1a
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i)
   {
-    if ((allowedTypes & (1 << i)) &&
-        (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-    {
-      return i;
-    }
+    hash ^= bytes[i];
+    hash *= FNV_PRIME;
   }
-
-  return uint32_t();
+  return hash;
 }
 
-static void createBuffer(VkPhysicalDevice physicalDevice,
-                         VkDevice device,
+static void createBuffer(VkDevice device,
+                         DeviceAllocator& allocator,
                          VkDeviceSize bufferSize,
                          VkBufferUsageFlags bufferUsage,
                          VkMemoryPropertyFlags bufferProperties,
                          VkBuffer* buffer,
-                         VkDeviceMemory* bufferMemory,
-                         VkAllocationCallbacks* a_pAllocCB)
+                         DeviceAllocation* bufferMemory,
+                         VkAllocationCallbacks* a_pAllocCB,
+                         AllocationStrategy strategy = AllocationStrategy::Buddy)
 {
   // Information to create a buffer (doesn't include assigning memory)
   VkBufferCreateInfo bufferInfo = {};
@@ -108,28 +164,30 @@ static void createBuffer(VkPhysicalDevice physicalDevice,
     throw std::runtime_error("Unable to create buffer");
   }
 
-  // Get buffer memory requirements
-  VkMemoryRequirements memReqs = {};
-  vkGetBufferMemoryRequirements(device, *buffer, &memReqs);
-
-  // Allocate memory to buffer
-  VkMemoryAllocateInfo memAllocInfo = {};
-  memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  memAllocInfo.allocationSize = memReqs.size;
-  memAllocInfo.memoryTypeIndex = findMemoryTypeIndex(physicalDevice,
-                                                     memReqs.memoryTypeBits,
-                                                     bufferProperties);
-
-  // Allocate memory to VkDeviceMemory
-  if (vkAllocateMemory(device, &memAllocInfo, a_pAllocCB, bufferMemory) != VK_SUCCESS)
-  {
-    throw std::runtime_error("Failed to allocate vertex buffer memory");
-  }
+  // Sub-allocate memory matching the buffer memory requirements and bind it to the buffer
+  *bufferMemory = allocator.allocateBuffer(*buffer, bufferProperties, strategy);
+}
 
-  // Allocate memory to given vertex buffer
-  if (vkBindBufferMemory(device, *buffer, *bufferMemory, 0) != VK_SUCCESS)
+// Planes of the view frustum, normals point inside and are normalized so the distance to a sphere center can be
+// compared to its radius. Order is left, right, bottom, top, near, far. Clip space depth is 0 to 1.
+static void getFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+  // Rows of the matrix, glm is column major
+  glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+  glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+  glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+  glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+  planes[0] = row3 + row0;
+  planes[1] = row3 - row0;
+  planes[2] = row3 + row1;
+  planes[3] = row3 - row1;
+  planes[4] = row2;
+  planes[5] = row3 - row2;
+
+  for (int i = 0; i < 6; ++i)
   {
-    throw std::runtime_error("Failed to bind buffer memory vertex buffer");
+    planes[i] /= glm::length(glm::vec3(planes[i]));
   }
 }
 
@@ -196,16 +254,18 @@ static void copyImageBuffer(VkDevice device,
                             VkBuffer srcBuffer,
                             VkImage dstImage,
                             uint32_t width,
-                            uint32_t height)
+                            uint32_t height,
+                            VkDeviceSize bufferOffset = 0,
+                            uint32_t mipLevel = 0)
 {
   auto commandBuffer = beginCommandBuffer(device, transferCmdPool);
 
   VkBufferImageCopy region = {};
-  region.bufferOffset = 0;                                            // Offset into buffer data
+  region.bufferOffset = bufferOffset;                                 // Offset into buffer data
   region.bufferRowLength = 0;                                         // Row length of data to calculate data spacing
   region.bufferImageHeight = 0;                                       // Image height to calculate data spacing
   region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;     // Aspect of image to copy
-  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.mipLevel = mipLevel;
   region.imageSubresource.baseArrayLayer = 0;
   region.imageSubresource.layerCount = 1;
   region.imageOffset = {0, 0, 0};
@@ -222,7 +282,8 @@ static void transitionImageLayout(VkDevice device,
                                   VkCommandPool commandPool,
                                   VkImage image,
                                   VkImageLayout oldLayout,
-                                  VkImageLayout newLayout)
+                                  VkImageLayout newLayout,
+                                  uint32_t mipLevels = 1)
 {
   VkImageMemoryBarrier imgMemoryBarrier = {};
 
@@ -263,7 +324,7 @@ static void transitionImageLayout(VkDevice device,
   imgMemoryBarrier.image = image;
   imgMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
   imgMemoryBarrier.subresourceRange.baseMipLevel = 0;
-  imgMemoryBarrier.subresourceRange.levelCount = 1;
+  imgMemoryBarrier.subresourceRange.levelCount = mipLevels;
   imgMemoryBarrier.subresourceRange.baseArrayLayer = 0;
   imgMemoryBarrier.subresourceRange.layerCount = 1;
 
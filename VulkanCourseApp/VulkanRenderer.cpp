@@ -1,12 +1,85 @@
 #include "VulkanRenderer.h"
 #include <iostream>
 #include <array>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iterator>
 
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
-#define USING_PUSH_CONSTANT
+// Initial size of each frame's partition of the ring buffer, it grows when a frame needs more
+static const VkDeviceSize FRAME_DATA_SIZE = 64 * 1024;
+
+// Below this many draws per secondary command buffer, recording on more threads costs more than it saves
+static const size_t MIN_DRAWS_PER_CHUNK = 64;
+
+// Initial capacity of the shared geometry buffers, they grow when full
+static const uint32_t GEOMETRY_VERTEX_CAPACITY = 256 * 1024;
+static const uint32_t GEOMETRY_INDEX_CAPACITY = 1024 * 1024;
+static const uint32_t GEOMETRY_MESHLET_CAPACITY = 16 * 1024;
+
+// Initial count of texture sets of the sampler pool without descriptor indexing, the next pools double it
+static const uint32_t SAMPLER_POOL_SET_COUNT = 64;
+
+// Largest error of a LOD on screen, in pixels
+static const float LOD_PIXEL_ERROR = 1.0f;
+
+// Baked textures aren't rebuilt by the renderer, one older than its image is ignored
+static bool isBakedTextureCurrent(const std::string& fileLoc)
+{
+  std::error_code error;
+  auto bakedTime = std::filesystem::last_write_time(fileLoc + ".baked", error);
+  if (error)
+  {
+    return false;
+  }
+  auto imageTime = std::filesystem::last_write_time(fileLoc, error);
+  return error || bakedTime >= imageTime;
+}
+
+static uint32_t getVertexSize(VertexFormat format)
+{
+  return format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+// Shaders read floats from both formats, packed attributes are normalized or half floats converted by the input stage
+static void getVertexInputDescriptions(VertexFormat format,
+                                       VkVertexInputBindingDescription& bindingDesc,
+                                       std::array<VkVertexInputAttributeDescription, 3>& attribDescs)
+{
+  bindingDesc.binding = 0;
+  bindingDesc.stride = getVertexSize(format);
+  bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+  // Position, color and texcoord attributes
+  for (uint32_t i = 0; i < attribDescs.size(); ++i)
+  {
+    attribDescs[i].binding = 0;
+    attribDescs[i].location = i;
+  }
+
+  if (format == VertexFormat::Packed)
+  {
+    attribDescs[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+    attribDescs[0].offset = offsetof(PackedVertex, pos);
+    attribDescs[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+    attribDescs[1].offset = offsetof(PackedVertex, col);
+    attribDescs[2].format = VK_FORMAT_R16G16_SFLOAT;
+    attribDescs[2].offset = offsetof(PackedVertex, tex);
+  }
+  else
+  {
+    attribDescs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attribDescs[0].offset = offsetof(Vertex, pos);
+    attribDescs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attribDescs[1].offset = offsetof(Vertex, col);
+    attribDescs[2].format = VK_FORMAT_R32G32_SFLOAT;
+    attribDescs[2].offset = offsetof(Vertex, tex);
+  }
+}
 
 static const std::vector<const char*> validationLayers =
 {
@@ -60,10 +133,39 @@ VulkanRenderer::VulkanRenderer()
 , m_bValidationLayers(true)
 #endif
 , minUniformBufferOffset(256)
-, modelUniformAlignment(256)
-, modelTransferSpace(nullptr)
+, minStorageBufferOffset(256)
+, vpUniformOffset(0)
+, objectDataOffset(0)
+, instanceIndicesOffset(0)
+, instancedPipeline(VK_NULL_HANDLE)
+, instancingSupported(false)
+, indirectDrawSupported(false)
+, indirectDrawEnabled(false)
+, indirectCountSupported(false)
+, indirectCommandsOffset(0)
+, indirectCountsOffset(0)
+, cullDrawsOffset(0)
+, cullDrawCount(0)
+, pfnCmdDrawIndexedIndirectCount(nullptr)
+, gpuCullingSupported(false)
+, gpuCullingEnabled(false)
+, gpuVisibleCount(0)
+, clusterCullingSupported(false)
+, clusterCullingEnabled(false)
+, cpuCullingEnabled(true)
+, cpuCullTime(0.0f)
+, lodSelectionEnabled(true)
 , samplerAnisotropySupported(false)
+, compressedTexturesSupported(false)
+, vertexFormat(VertexFormat::Float)
+, compactVerticesEnabled(true)
+, compactVerticesSupported(false)
+, bindlessTexturesSupported(false)
+, textureArraySize(0)
+, textureDescriptorCount(0)
+, textureArrayDescriptorSet(VK_NULL_HANDLE)
 {
+  visibleCountOffsets.fill(VK_WHOLE_SIZE);
 }
 
 VulkanRenderer::~VulkanRenderer()
@@ -81,27 +183,31 @@ int VulkanRenderer::init(GLFWwindow* a_pWindow)
     createSurface();
     getPhysicalDevice();
     createLogicalDevice();
+    deviceAllocator.init(mainDevice.physicalDevice, mainDevice.logicalDevice, m_pAllocCB);
+    vertexFormat = compactVerticesEnabled && compactVerticesSupported ? VertexFormat::Packed : VertexFormat::Float;
+    geometryArena.init(mainDevice.logicalDevice, deviceAllocator, getVertexSize(vertexFormat), GEOMETRY_VERTEX_CAPACITY,
+                       GEOMETRY_INDEX_CAPACITY, GEOMETRY_MESHLET_CAPACITY, m_pAllocCB);
     createSwapChain();
     createColorBufferImage();
     createDepthBuffer();
     createRenderPass();
     createDescriptorSetLayout();
-#ifdef USING_PUSH_CONSTANT
     createPushConstantRange();
-#endif
     createGraphicsPipeline();
     createFramebuffers();
     createCommandPool();
     createCommandBuffers();
     createTextureSampler();
-#ifndef USING_PUSH_CONSTANT
-    allocateDynamicBufferTransferSpace();
-#endif
     createUniformBuffers();
     createDescriptorPool();
     createDescriptorSets();
     createInputDescriptorSets();
+    createCullingPipeline();
     createSynchronization();
+
+    QueueFamilyIndices indices = getQueueFamilies(mainDevice.physicalDevice);
+    textureStreamer.init(mainDevice.logicalDevice, deviceAllocator, transferQueue, indices.transferFamily, indices.graphicsFamily,
+                         ThreadPool::DefaultWorkerCount(), m_pAllocCB);
   }
   catch (const std::runtime_error& e)
   {
@@ -115,7 +221,8 @@ int VulkanRenderer::init(GLFWwindow* a_pWindow)
   // Vulkan Y-up is inverted compared to OpenGL
   uboViewProjection.projection[1][1] *= -1.0f;
 
-  createTexture("plain.png");
+  // Placeholder of the textures being streamed, loaded before anything is drawn
+  textureDescriptors.push_back(loadTexture("plain.png"));
 
   return EXIT_SUCCESS;
 }
@@ -127,7 +234,8 @@ void VulkanRenderer::updateModel(unsigned int modelId, const glm::mat4& newModel
     return;
   }
 
-  modelList[modelId]->setModelMatrix(newModel);
+  // Only the model's subtree is recomputed by the next update
+  sceneGraph.setLocalTransform(modelList[modelId]->getRootNode(), newModel);
 }
 
 void VulkanRenderer::draw()
@@ -137,12 +245,19 @@ void VulkanRenderer::draw()
   // Manually reset (close) the fence
   vkResetFences(mainDevice.logicalDevice, 1, &drawFences[currentFrame]);
 
+  destroyRetiredTextures(false);
+
+  // Textures uploaded since the last frame replace their placeholder from this frame on
+  updateTextureStreaming();
+
   // Get the next available image to draw to and set signal when we're finished with the image (semaphore)
   uint32_t imageIndex = 0;
   vkAcquireNextImageKHR(mainDevice.logicalDevice, swapchain, std::numeric_limits<uint64_t>::max(), imageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex);
 
+  // Uniforms first, the commands use the offsets of this frame's allocations
+  buildDrawList();
+  updateUniformBuffers();
   recordCommands(imageIndex);
-  updateUniformBuffers(imageIndex);
 
   // Submit command buffer to queue for execution, make sure ti waits for image to be signalled as available before drawing
   // and signals when it has finished rendering
@@ -189,24 +304,29 @@ void VulkanRenderer::cleanup()
   // Wait until no actions being run on device before destroying
   vkDeviceWaitIdle(mainDevice.logicalDevice);
 
-#ifndef USING_PUSH_CONSTANT
-  _aligned_free(modelTransferSpace);
-  modelTransferSpace = nullptr;
-#endif
+  textureStreamer.destroy();
 
+  // Assets go away with their last model, giving back their texture references
   for (auto& model : modelList)
   {
     delete model;
   }
   modelList.clear();
+  meshAssets.clear();
+  geometryArena.destroy();
+  destroyRetiredTextures(true);
 
   vkDestroySampler(mainDevice.logicalDevice, textureSampler, m_pAllocCB);
 
   for (size_t i = 0; i < textureImages.size(); ++i)
   {
+    if (textureImages[i] == VK_NULL_HANDLE)
+    {
+      continue;
+    }
     vkDestroyImageView(mainDevice.logicalDevice, textureImageViews[i], m_pAllocCB);
     vkDestroyImage(mainDevice.logicalDevice, textureImages[i], m_pAllocCB);
-    vkFreeMemory(mainDevice.logicalDevice, textureImageMemory[i], m_pAllocCB);
+    deviceAllocator.free(textureImageMemory[i]);
   }
   textureImages.clear();
   textureImageMemory.clear();
@@ -216,34 +336,31 @@ void VulkanRenderer::cleanup()
   {
     vkDestroyImageView(mainDevice.logicalDevice, colorBufferImageView[i], m_pAllocCB);
     vkDestroyImage(mainDevice.logicalDevice, colorBufferImage[i], m_pAllocCB);
-    vkFreeMemory(mainDevice.logicalDevice, colorBufferImageMemory[i], m_pAllocCB);
+    deviceAllocator.free(colorBufferImageMemory[i]);
   }
 
   for (size_t i = 0; i < depthBufferImage.size(); ++i)
   {
     vkDestroyImageView(mainDevice.logicalDevice, depthBufferImageView[i], m_pAllocCB);
     vkDestroyImage(mainDevice.logicalDevice, depthBufferImage[i], m_pAllocCB);
-    vkFreeMemory(mainDevice.logicalDevice, depthBufferImageMemory[i], m_pAllocCB);
+    deviceAllocator.free(depthBufferImageMemory[i]);
   }
 
   vkDestroyDescriptorPool(mainDevice.logicalDevice, descriptorPool, m_pAllocCB);
   vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, descSetLayout, m_pAllocCB);
 
-  vkDestroyDescriptorPool(mainDevice.logicalDevice, samplerDescriptorPool, m_pAllocCB);
+  for (auto pool : samplerDescriptorPools)
+  {
+    vkDestroyDescriptorPool(mainDevice.logicalDevice, pool, m_pAllocCB);
+  }
   vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, samplerSetLayout, m_pAllocCB);
 
   vkDestroyDescriptorPool(mainDevice.logicalDevice, inputDescriptorPool, m_pAllocCB);
   vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, inputSetLayout, m_pAllocCB);
 
-  for (size_t i = 0; i < swapChainImages.size(); ++i)
-  {
-    vkDestroyBuffer(mainDevice.logicalDevice, vpUniformBuffer[i], m_pAllocCB);
-    vkFreeMemory(mainDevice.logicalDevice, vpUniformBufferMemory[i], m_pAllocCB);
-#ifndef USING_PUSH_CONSTANT
-    vkDestroyBuffer(mainDevice.logicalDevice, modelUniformBufferDynamic[i], m_pAllocCB);
-    vkFreeMemory(mainDevice.logicalDevice, modelUniformBufferMemoryDynamic[i], m_pAllocCB);
-#endif
-  }
+  gpuCuller.destroy();
+  clusterCuller.destroy();
+  frameData.destroy();
 
   for (int i = 0; i < MAX_FRAME_DRAWS; ++i)
   {
@@ -251,6 +368,12 @@ void VulkanRenderer::cleanup()
     vkDestroySemaphore(mainDevice.logicalDevice, imageAvailable[i], m_pAllocCB);
     vkDestroyFence(mainDevice.logicalDevice, drawFences[i], m_pAllocCB);
   }
+  for (auto& pool : secondaryCommandPools)
+  {
+    vkDestroyCommandPool(mainDevice.logicalDevice, pool, m_pAllocCB);
+  }
+  secondaryCommandPools.clear();
+  secondaryCommandBuffers.clear();
   vkDestroyCommandPool(mainDevice.logicalDevice, graphicsCommandPool, m_pAllocCB);
   for (auto& framebuffer : swapChainFramebuffers)
   {
@@ -259,6 +382,10 @@ void VulkanRenderer::cleanup()
   vkDestroyPipeline(mainDevice.logicalDevice, secondPipeline, m_pAllocCB);
   vkDestroyPipelineLayout(mainDevice.logicalDevice, secondPipelineLayout, m_pAllocCB);
   vkDestroyPipeline(mainDevice.logicalDevice, graphicsPipeline, m_pAllocCB);
+  if (instancedPipeline != VK_NULL_HANDLE)
+  {
+    vkDestroyPipeline(mainDevice.logicalDevice, instancedPipeline, m_pAllocCB);
+  }
   vkDestroyPipelineLayout(mainDevice.logicalDevice, pipelineLayout, m_pAllocCB);
   vkDestroyRenderPass(mainDevice.logicalDevice, renderPass, m_pAllocCB);
   for (auto& image : swapChainImages)
@@ -267,6 +394,13 @@ void VulkanRenderer::cleanup()
   }
   vkDestroySwapchainKHR(mainDevice.logicalDevice, swapchain, m_pAllocCB);
   vkDestroySurfaceKHR(instance, surface, m_pAllocCB);
+
+  if (m_bValidationLayers)
+  {
+    deviceAllocator.printStats();
+  }
+  deviceAllocator.destroy();
+
   vkDestroyDevice(mainDevice.logicalDevice, m_pAllocCB);
 
   if (m_bValidationLayers)
@@ -370,7 +504,7 @@ void VulkanRenderer::createLogicalDevice()
   QueueFamilyIndices indices = getQueueFamilies(mainDevice.physicalDevice);
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<int> queueFamilyIndices = { indices.graphicsFamily, indices.presentationFamily };
+  std::set<int> queueFamilyIndices = { indices.graphicsFamily, indices.presentationFamily, indices.transferFamily };
 
   for (int queueFamilyIndex : queueFamilyIndices)
   {
@@ -388,8 +522,17 @@ void VulkanRenderer::createLogicalDevice()
   deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
-  deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()); // Number of enabled logical device extensions.
-  deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  std::vector<const char*> enabledExtensions = deviceExtensions;
+  if (indirectCountSupported)
+  {
+    enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+  }
+  if (bindlessTexturesSupported)
+  {
+    enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+  }
+  deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size()); // Number of enabled logical device extensions.
+  deviceCreateInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
   // Deprecated in Vulkan 1.1
   deviceCreateInfo.enabledLayerCount = 0;
@@ -397,8 +540,24 @@ void VulkanRenderer::createLogicalDevice()
 
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = samplerAnisotropySupported ? VK_TRUE : VK_FALSE;
+  deviceFeatures.textureCompressionBC = compressedTexturesSupported ? VK_TRUE : VK_FALSE;
+  deviceFeatures.multiDrawIndirect = indirectDrawSupported ? VK_TRUE : VK_FALSE;
+  deviceFeatures.drawIndirectFirstInstance = indirectDrawSupported ? VK_TRUE : VK_FALSE;
   deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
+  // Texture array indexed per instance, partially filled and updated while frames using it are in flight
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+  indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  if (bindlessTexturesSupported)
+  {
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+    deviceCreateInfo.pNext = &indexingFeatures;
+  }
+
   // Create the logical device
   if (vkCreateDevice(mainDevice.physicalDevice, &deviceCreateInfo, m_pAllocCB, &mainDevice.logicalDevice) != VK_SUCCESS)
   {
@@ -408,6 +567,13 @@ void VulkanRenderer::createLogicalDevice()
   // Queues are created at the same time as the device
   vkGetDeviceQueue(mainDevice.logicalDevice, indices.graphicsFamily, 0, &graphicsQueue);
   vkGetDeviceQueue(mainDevice.logicalDevice, indices.presentationFamily, 0, &presentationQueue);
+  vkGetDeviceQueue(mainDevice.logicalDevice, indices.transferFamily, 0, &transferQueue);
+
+  if (indirectCountSupported)
+  {
+    pfnCmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR) vkGetDeviceProcAddr(mainDevice.logicalDevice, "vkCmdDrawIndexedIndirectCountKHR");
+    indirectCountSupported = pfnCmdDrawIndexedIndirectCount != nullptr;
+  }
 }
 
 void VulkanRenderer::createSurface()
@@ -632,33 +798,31 @@ void VulkanRenderer::createRenderPass()
 void VulkanRenderer::createDescriptorSetLayout()
 {
   // Uniform value DescriptorSetLayout
-#ifndef USING_PUSH_CONSTANT
-  std::array<VkDescriptorSetLayoutBinding, 2> layoutBindings = {};
-#else
-  std::array<VkDescriptorSetLayoutBinding, 1> layoutBindings = {};
-#endif
+  std::array<VkDescriptorSetLayoutBinding, 3> layoutBindings = {};
 
   // ViewProjection binding info
   VkDescriptorSetLayoutBinding& vpLayoutBinding = layoutBindings[0];
   vpLayoutBinding.binding = 0;           // Must match the binding number in the shader
-  vpLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  vpLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
   vpLayoutBinding.descriptorCount = 1;
   vpLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
   vpLayoutBinding.pImmutableSamplers = nullptr;
 
-#ifndef USING_PUSH_CONSTANT
-  // Model binding info
-  VkDescriptorSetLayoutBinding& modelLayoutBinding = layoutBindings[1];
-  modelLayoutBinding.binding = 1;           // Must match the binding number in the shader
-  modelLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-  modelLayoutBinding.descriptorCount = 1;
-  modelLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-  modelLayoutBinding.pImmutableSamplers = nullptr;
-
-  const VkDescriptorSetLayoutBinding* bindings[] = { &vpLayoutBinding, &modelLayoutBinding };
-#else
-  const VkDescriptorSetLayoutBinding* bindings[] = { &vpLayoutBinding };
-#endif
+  // Object data binding info, only read by the instanced pipeline
+  VkDescriptorSetLayoutBinding& objectLayoutBinding = layoutBindings[layoutBindings.size() - 2];
+  objectLayoutBinding.binding = 2;           // Must match the binding number in the shader
+  objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  objectLayoutBinding.descriptorCount = 1;
+  objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  objectLayoutBinding.pImmutableSamplers = nullptr;
+
+  // Instance indices binding info, object data index of each instance
+  VkDescriptorSetLayoutBinding& instanceLayoutBinding = layoutBindings.back();
+  instanceLayoutBinding.binding = 3;           // Must match the binding number in the shader
+  instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  instanceLayoutBinding.descriptorCount = 1;
+  instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  instanceLayoutBinding.pImmutableSamplers = nullptr;
 
   VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
   layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -670,25 +834,7 @@ void VulkanRenderer::createDescriptorSetLayout()
     throw std::runtime_error("Failed to create uniform descriptor set layout");
   }
 
-  // Sampler DescriptorSetLayout
-
-  // Sampler binding info
-  VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-  samplerLayoutBinding.binding = 0;           // Must match the binding number in the shader
-  samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  samplerLayoutBinding.descriptorCount = 1;
-  samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-  samplerLayoutBinding.pImmutableSamplers = nullptr;
-
-  VkDescriptorSetLayoutCreateInfo textureLayoutCreateInfo = {};
-  textureLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  textureLayoutCreateInfo.bindingCount = 1;
-  textureLayoutCreateInfo.pBindings = &samplerLayoutBinding;
-
-  if (vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &textureLayoutCreateInfo, m_pAllocCB, &samplerSetLayout) != VK_SUCCESS)
-  {
-    throw std::runtime_error("Failed to create sampler descriptor set layout");
-  }
+  createSamplerSetLayout();
 
   // Input attachment image descriptor set layout
   std::array<VkDescriptorSetLayoutBinding, 2> inputBindings = {};
@@ -717,6 +863,43 @@ void VulkanRenderer::createDescriptorSetLayout()
   }
 }
 
+void VulkanRenderer::createSamplerSetLayout()
+{
+  // Sampler binding info, a single texture per set or the whole texture array
+  VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
+  samplerLayoutBinding.binding = 0;           // Must match the binding number in the shader
+  samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  samplerLayoutBinding.descriptorCount = bindlessTexturesSupported ? textureArraySize : 1;
+  samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  samplerLayoutBinding.pImmutableSamplers = nullptr;
+
+  VkDescriptorSetLayoutCreateInfo textureLayoutCreateInfo = {};
+  textureLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  textureLayoutCreateInfo.bindingCount = 1;
+  textureLayoutCreateInfo.pBindings = &samplerLayoutBinding;
+
+  // Elements past the loaded textures are never read, new textures are written while the set is bound
+  VkDescriptorBindingFlagsEXT textureBindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                                                    VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                                                    VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT textureBindingFlagsCreateInfo = {};
+  textureBindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+  textureBindingFlagsCreateInfo.bindingCount = 1;
+  textureBindingFlagsCreateInfo.pBindingFlags = &textureBindingFlags;
+
+  if (bindlessTexturesSupported)
+  {
+    textureLayoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    textureLayoutCreateInfo.pNext = &textureBindingFlagsCreateInfo;
+  }
+
+  if (vkCreateDescriptorSetLayout(mainDevice.logicalDevice, &textureLayoutCreateInfo, m_pAllocCB, &samplerSetLayout) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create sampler descriptor set layout");
+  }
+}
+
 void VulkanRenderer::createPushConstantRange()
 {
   pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
@@ -727,11 +910,7 @@ void VulkanRenderer::createPushConstantRange()
 void VulkanRenderer::createGraphicsPipeline()
 {
   // Read shader files
-#ifndef USING_PUSH_CONSTANT
-  auto vertexShader = readFile("Shaders/vert.spv");
-#else
   auto vertexShader = readFile("Shaders/vertPushConstant.spv");
-#endif
   auto fragmentShader = readFile("Shaders/frag.spv");
 
   // Build shader modules to link to graphics pipeline
@@ -757,29 +936,8 @@ void VulkanRenderer::createGraphicsPipeline()
   // Create pipeline
   //
   VkVertexInputBindingDescription bindingDesc = {};
-  bindingDesc.binding = 0;
-  bindingDesc.stride = sizeof(Vertex);
-  bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
   std::array<VkVertexInputAttributeDescription, 3> attribDescs = {};
-
-  // Position attribute
-  attribDescs[0].binding = 0;
-  attribDescs[0].location = 0;
-  attribDescs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attribDescs[0].offset = offsetof(Vertex, pos);          // Find offset in struct for pos attribute
-
-  // Color attribute
-  attribDescs[1].binding = 0;
-  attribDescs[1].location = 1;
-  attribDescs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-  attribDescs[1].offset = offsetof(Vertex, col);          // Find offset in struct for pos attribute
-
-  // Texcoord attribute
-  attribDescs[2].binding = 0;
-  attribDescs[2].location = 2;
-  attribDescs[2].format = VK_FORMAT_R32G32_SFLOAT;
-  attribDescs[2].offset = offsetof(Vertex, tex);          // Find offset in struct for pos attribute
+  getVertexInputDescriptions(vertexFormat, bindingDesc, attribDescs);
 
   // Vertex input
   VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
@@ -875,13 +1033,8 @@ void VulkanRenderer::createGraphicsPipeline()
   layoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   layoutCreateInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
   layoutCreateInfo.pSetLayouts = descriptorSetLayouts.data();
-#ifndef USING_PUSH_CONSTANT
-  layoutCreateInfo.pushConstantRangeCount = 0;
-  layoutCreateInfo.pPushConstantRanges = nullptr;
-#else
   layoutCreateInfo.pushConstantRangeCount = 1;
   layoutCreateInfo.pPushConstantRanges = &pushConstantRange;
-#endif
 
   if (vkCreatePipelineLayout(mainDevice.logicalDevice, &layoutCreateInfo, m_pAllocCB, &pipelineLayout) != VK_SUCCESS)
   {
@@ -923,6 +1076,61 @@ void VulkanRenderer::createGraphicsPipeline()
     throw std::runtime_error("Failed to create graphics pipeline");
   }
 
+  // Instanced pipeline only differs by its shaders, without it every draw is recorded on its own.
+  // With the texture array its fragment shader picks the texture from the instance's object data.
+  try
+  {
+    auto instancedVertexShader = readFile("Shaders/vertInstanced.spv");
+    auto instancedFragmentShader = bindlessTexturesSupported ? readFile("Shaders/fragBindless.spv") : std::vector<char>();
+    VkShaderModule instancedVertexShaderModule = createShaderModule(instancedVertexShader);
+    VkShaderModule instancedFragmentShaderModule = bindlessTexturesSupported ? createShaderModule(instancedFragmentShader) : fragmentShaderModule;
+
+    VkPipelineShaderStageCreateInfo instancedShaderStages[] = { vertexShaderCreateInfo, fragmentShaderCreateInfo };
+    instancedShaderStages[0].module = instancedVertexShaderModule;
+    instancedShaderStages[1].module = instancedFragmentShaderModule;
+    createInfo.pStages = instancedShaderStages;
+
+    VkResult result = vkCreateGraphicsPipelines(mainDevice.logicalDevice, VK_NULL_HANDLE, 1, &createInfo, m_pAllocCB, &instancedPipeline);
+    vkDestroyShaderModule(mainDevice.logicalDevice, instancedVertexShaderModule, m_pAllocCB);
+    if (instancedFragmentShaderModule != fragmentShaderModule)
+    {
+      vkDestroyShaderModule(mainDevice.logicalDevice, instancedFragmentShaderModule, m_pAllocCB);
+    }
+    createInfo.pStages = shaderStages;
+
+    if (result != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create instanced graphics pipeline");
+    }
+    instancingSupported = true;
+  }
+  catch (const std::runtime_error& e)
+  {
+    printf("Instancing and indirect drawing disabled: %s\n", e.what());
+    instancedPipeline = VK_NULL_HANDLE;
+    instancingSupported = false;
+  }
+
+  // Only the instanced pipeline can index the texture array, without it the pipelines are built again with a set per texture
+  if (bindlessTexturesSupported && !instancingSupported)
+  {
+    vkDestroyShaderModule(mainDevice.logicalDevice, fragmentShaderModule, m_pAllocCB);
+    vkDestroyShaderModule(mainDevice.logicalDevice, vertexShaderModule, m_pAllocCB);
+    vkDestroyPipeline(mainDevice.logicalDevice, graphicsPipeline, m_pAllocCB);
+    vkDestroyPipelineLayout(mainDevice.logicalDevice, pipelineLayout, m_pAllocCB);
+    vkDestroyDescriptorSetLayout(mainDevice.logicalDevice, samplerSetLayout, m_pAllocCB);
+
+    printf("Texture array disabled\n");
+    bindlessTexturesSupported = false;
+    createSamplerSetLayout();
+    createGraphicsPipeline();
+    return;
+  }
+
+  // Indirect draws also get their transform from the object data
+  indirectDrawSupported = indirectDrawSupported && instancingSupported;
+  indirectDrawEnabled = indirectDrawSupported;
+
   // Destroy shader module no longer needed after creating the pipeline
   vkDestroyShaderModule(mainDevice.logicalDevice, fragmentShaderModule, m_pAllocCB);
   vkDestroyShaderModule(mainDevice.logicalDevice, vertexShaderModule, m_pAllocCB);
@@ -1069,6 +1277,22 @@ void VulkanRenderer::createCommandPool()
   {
     throw std::runtime_error("Failed to create command pool");
   }
+
+  // Command pools can't be used from several threads, each thread records from its own pool.
+  // Pools are reset as a whole once the frame using them is done
+  VkCommandPoolCreateInfo secondaryPoolInfo = {};
+  secondaryPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  secondaryPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  secondaryPoolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+
+  secondaryCommandPools.resize(MAX_FRAME_DRAWS * threadPool.getThreadCount());
+  for (auto& pool : secondaryCommandPools)
+  {
+    if (vkCreateCommandPool(mainDevice.logicalDevice, &secondaryPoolInfo, m_pAllocCB, &pool) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to create secondary command pool");
+    }
+  }
 }
 
 void VulkanRenderer::createCommandBuffers()
@@ -1086,6 +1310,22 @@ void VulkanRenderer::createCommandBuffers()
   {
     throw std::runtime_error("Failed to allocate command buffer");
   }
+
+  // One secondary command buffer in each secondary pool
+  secondaryCommandBuffers.resize(secondaryCommandPools.size());
+  for (size_t i = 0; i < secondaryCommandPools.size(); ++i)
+  {
+    VkCommandBufferAllocateInfo secondaryAllocInfo = {};
+    secondaryAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    secondaryAllocInfo.commandPool = secondaryCommandPools[i];
+    secondaryAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    secondaryAllocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(mainDevice.logicalDevice, &secondaryAllocInfo, &secondaryCommandBuffers[i]) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to allocate secondary command buffer");
+    }
+  }
 }
 
 void VulkanRenderer::createSynchronization()
@@ -1120,7 +1360,7 @@ void VulkanRenderer::createTextureSampler()
   VkSamplerCreateInfo samplerCreateInfo = {};
   samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
   samplerCreateInfo.minLod = 0.0f;
-  samplerCreateInfo.maxLod = 0.0f;
+  samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;                // Every level of the mip chain
   samplerCreateInfo.mipLodBias = 0.0f;
   samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
   samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
@@ -1141,65 +1381,29 @@ void VulkanRenderer::createTextureSampler()
 
 void VulkanRenderer::createUniformBuffers()
 {
-  VkDeviceSize vpBufferSize = sizeof(UboViewProjection);
-
-  VkDeviceSize modelBufferSize = modelUniformAlignment * MAX_OBJECTS;
-
-  // One uniform buffer for each image and command buffer
-  vpUniformBuffer.resize(swapChainImages.size());
-  vpUniformBufferMemory.resize(swapChainImages.size());
-
-#ifndef USING_PUSH_CONSTANT
-  modelUniformBufferDynamic.resize(swapChainImages.size());
-  modelUniformBufferMemoryDynamic.resize(swapChainImages.size());
-#endif
-
-  for (size_t i = 0; i < swapChainImages.size(); ++i)
-  {
-    createBuffer(mainDevice.physicalDevice,
-                 mainDevice.logicalDevice,
-                 vpBufferSize,
-                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 &vpUniformBuffer[i],
-                 &vpUniformBufferMemory[i],
-                 m_pAllocCB);
-
-#ifndef USING_PUSH_CONSTANT
-    createBuffer(mainDevice.physicalDevice,
-                 mainDevice.logicalDevice,
-                 modelBufferSize,
-                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 &modelUniformBufferDynamic[i],
-                 &modelUniformBufferMemoryDynamic[i],
+  // All per-frame data comes from one ring buffer, partitioned by frame in flight
+  frameData.init(mainDevice.logicalDevice,
+                 deviceAllocator,
+                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                 std::max(minUniformBufferOffset, minStorageBufferOffset),
+                 FRAME_DATA_SIZE,
+                 MAX_FRAME_DRAWS,
                  m_pAllocCB);
-#endif
-  }
 }
 
 void VulkanRenderer::createDescriptorPool()
 {
-  // Uniform descriptor pool
-#ifndef USING_PUSH_CONSTANT
+  // Uniform descriptor pool, a single set since the frames only differ by their dynamic offsets
   std::array<VkDescriptorPoolSize, 2> poolSizes = {};
-#else
-  std::array<VkDescriptorPoolSize, 1> poolSizes = {};
-#endif
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  poolSizes[0].descriptorCount = 1;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  poolSizes[1].descriptorCount = 2;
 
-  VkDescriptorPoolSize& vpPoolSize = poolSizes[0];
-  vpPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  vpPoolSize.descriptorCount = static_cast<uint32_t>(vpUniformBuffer.size());
-
-#ifndef USING_PUSH_CONSTANT
-  VkDescriptorPoolSize& modelPoolSize = poolSizes[1];
-  modelPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-  modelPoolSize.descriptorCount = static_cast<uint32_t>(modelUniformBufferDynamic.size());
-#endif
   VkDescriptorPoolCreateInfo poolCreateInfo = {};
   poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  poolCreateInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
-  poolCreateInfo.poolSizeCount = poolSizes.size();
+  poolCreateInfo.maxSets = 1;
+  poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
   poolCreateInfo.pPoolSizes = poolSizes.data();
   poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
 
@@ -1208,21 +1412,8 @@ void VulkanRenderer::createDescriptorPool()
     throw std::runtime_error("Failed to create descriptor pool");
   }
 
-  // Sampler descriptor pool
-  VkDescriptorPoolSize samplerPoolSize = {};
-  samplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  samplerPoolSize.descriptorCount = MAX_OBJECTS;
-
-  VkDescriptorPoolCreateInfo samplerPoolCreateInfo = {};
-  samplerPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  samplerPoolCreateInfo.maxSets = MAX_OBJECTS;
-  samplerPoolCreateInfo.poolSizeCount = 1;
-  samplerPoolCreateInfo.pPoolSizes = &samplerPoolSize;
-
-  if (vkCreateDescriptorPool(mainDevice.logicalDevice, &samplerPoolCreateInfo, m_pAllocCB, &samplerDescriptorPool) != VK_SUCCESS)
-  {
-    throw std::runtime_error("Failed to create sampler descriptor pool");
-  }
+  // Sampler descriptor pool, a set per texture or the single texture array set
+  createSamplerDescriptorPool(bindlessTexturesSupported ? 1 : SAMPLER_POOL_SET_COUNT);
 
   // Input attachment descriptor pool
   std::array<VkDescriptorPoolSize, 2> inputPoolSize = {};
@@ -1246,65 +1437,99 @@ void VulkanRenderer::createDescriptorPool()
   }
 }
 
-void VulkanRenderer::createDescriptorSets()
+void VulkanRenderer::createSamplerDescriptorPool(uint32_t setCount)
 {
-  descriptorSets.resize(swapChainImages.size());
+  VkDescriptorPoolSize samplerPoolSize = {};
+  samplerPoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  samplerPoolSize.descriptorCount = bindlessTexturesSupported ? textureArraySize : setCount;
+
+  VkDescriptorPoolCreateInfo samplerPoolCreateInfo = {};
+  samplerPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  samplerPoolCreateInfo.maxSets = setCount;
+  samplerPoolCreateInfo.poolSizeCount = 1;
+  samplerPoolCreateInfo.pPoolSizes = &samplerPoolSize;
+  samplerPoolCreateInfo.flags = bindlessTexturesSupported ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT : 0;
+
+  VkDescriptorPool samplerDescriptorPool;
+  if (vkCreateDescriptorPool(mainDevice.logicalDevice, &samplerPoolCreateInfo, m_pAllocCB, &samplerDescriptorPool) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to create sampler descriptor pool");
+  }
 
-  std::vector<VkDescriptorSetLayout> setLayouts(swapChainImages.size(), descSetLayout);
+  samplerDescriptorPools.push_back(samplerDescriptorPool);
+}
 
+void VulkanRenderer::createDescriptorSets()
+{
   VkDescriptorSetAllocateInfo setAllocInfo = {};
   setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
   setAllocInfo.descriptorPool = descriptorPool;
-  setAllocInfo.descriptorSetCount = static_cast<uint32_t>(setLayouts.size());
-  setAllocInfo.pSetLayouts = setLayouts.data();
+  setAllocInfo.descriptorSetCount = 1;
+  setAllocInfo.pSetLayouts = &descSetLayout;
 
-  if (vkAllocateDescriptorSets(mainDevice.logicalDevice, &setAllocInfo, descriptorSets.data()) != VK_SUCCESS)
+  if (vkAllocateDescriptorSets(mainDevice.logicalDevice, &setAllocInfo, &descriptorSet) != VK_SUCCESS)
   {
     throw std::runtime_error("Failed to allocate descriptor sets");
   }
 
-  for (size_t i = 0; i < swapChainImages.size(); ++i)
+  writeDescriptorSet();
+
+  // Texture array set, its elements are written as textures get created
+  if (bindlessTexturesSupported)
   {
-#ifndef USING_PUSH_CONSTANT
-    std::array<VkWriteDescriptorSet, 2> setWrites = {};
-#else
-    std::array<VkWriteDescriptorSet, 1> setWrites = {};
-#endif
-    // ViewProjection
-    VkDescriptorBufferInfo vpBufferInfo = {};
-    vpBufferInfo.buffer = vpUniformBuffer[i];
-    vpBufferInfo.offset = 0;
-    vpBufferInfo.range = sizeof(UboViewProjection);
-
-    VkWriteDescriptorSet& vpSetWrite = setWrites[0];
-    vpSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    vpSetWrite.dstSet = descriptorSets[i];       // Descriptor set to update
-    vpSetWrite.dstBinding = 0;                   // Must match binding in shader
-    vpSetWrite.dstArrayElement = 0;
-    vpSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    vpSetWrite.descriptorCount = 1;
-    vpSetWrite.pBufferInfo = &vpBufferInfo;
-
-#ifndef USING_PUSH_CONSTANT
-    // Model
-    VkDescriptorBufferInfo modelBufferInfo = {};
-    modelBufferInfo.buffer = modelUniformBufferDynamic[i];
-    modelBufferInfo.offset = 0;
-    modelBufferInfo.range = modelUniformAlignment;
-
-    VkWriteDescriptorSet& modelSetWrite = setWrites[1];
-    modelSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    modelSetWrite.dstSet = descriptorSets[i];       // Descriptor set to update
-    modelSetWrite.dstBinding = 1;                   // Must match binding in shader
-    modelSetWrite.dstArrayElement = 0;
-    modelSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    modelSetWrite.descriptorCount = 1;
-    modelSetWrite.pBufferInfo = &modelBufferInfo;
-#endif
-    vkUpdateDescriptorSets(mainDevice.logicalDevice, setWrites.size(), setWrites.data(), 0, nullptr);
+    VkDescriptorSetAllocateInfo textureAllocInfo = {};
+    textureAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    textureAllocInfo.descriptorPool = samplerDescriptorPools.back();
+    textureAllocInfo.descriptorSetCount = 1;
+    textureAllocInfo.pSetLayouts = &samplerSetLayout;
+
+    if (vkAllocateDescriptorSets(mainDevice.logicalDevice, &textureAllocInfo, &textureArrayDescriptorSet) != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to allocate texture array descriptor set");
+    }
   }
 }
 
+void VulkanRenderer::writeDescriptorSet()
+{
+  std::array<VkWriteDescriptorSet, 3> setWrites = {};
+  // ViewProjection
+  VkDescriptorBufferInfo vpBufferInfo = {};
+  vpBufferInfo.buffer = frameData.getBuffer();
+  vpBufferInfo.offset = 0;                     // Dynamic offset is added when binding
+  vpBufferInfo.range = sizeof(UboViewProjection);
+
+  VkWriteDescriptorSet& vpSetWrite = setWrites[0];
+  vpSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  vpSetWrite.dstSet = descriptorSet;           // Descriptor set to update
+  vpSetWrite.dstBinding = 0;                   // Must match binding in shader
+  vpSetWrite.dstArrayElement = 0;
+  vpSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  vpSetWrite.descriptorCount = 1;
+  vpSetWrite.pBufferInfo = &vpBufferInfo;
+
+  // Object data and instance indices, array sizes depend on the number of draws in the frame
+  VkDescriptorBufferInfo objectBufferInfo = {};
+  objectBufferInfo.buffer = frameData.getBuffer();
+  objectBufferInfo.offset = 0;
+  objectBufferInfo.range = VK_WHOLE_SIZE;
+
+  VkWriteDescriptorSet& objectSetWrite = setWrites[setWrites.size() - 2];
+  objectSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  objectSetWrite.dstSet = descriptorSet;
+  objectSetWrite.dstBinding = 2;
+  objectSetWrite.dstArrayElement = 0;
+  objectSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  objectSetWrite.descriptorCount = 1;
+  objectSetWrite.pBufferInfo = &objectBufferInfo;
+
+  VkWriteDescriptorSet& instanceSetWrite = setWrites.back();
+  instanceSetWrite = objectSetWrite;
+  instanceSetWrite.dstBinding = 3;
+
+  vkUpdateDescriptorSets(mainDevice.logicalDevice, setWrites.size(), setWrites.data(), 0, nullptr);
+}
+
 void VulkanRenderer::createInputDescriptorSets()
 {
   inputDescriptorSets.resize(swapChainImages.size());
@@ -1358,119 +1583,567 @@ void VulkanRenderer::createInputDescriptorSets()
   }
 }
 
-void VulkanRenderer::updateUniformBuffers(uint32_t imageIndex)
+void VulkanRenderer::createCullingPipeline()
 {
-  // Copy VP data
-  void* data;
-  vkMapMemory(mainDevice.logicalDevice, vpUniformBufferMemory[imageIndex], 0, sizeof(UboViewProjection), 0, &data);
-  memcpy(data, &uboViewProjection, sizeof(UboViewProjection));
-  vkUnmapMemory(mainDevice.logicalDevice, vpUniformBufferMemory[imageIndex]);
+  // Culling writes the commands of the indirect draws, it is disabled along with them
+  gpuCullingSupported = gpuCullingSupported && indirectDrawSupported;
+  if (gpuCullingSupported)
+  {
+    try
+    {
+      gpuCuller.init(mainDevice.logicalDevice, "Shaders/cull.spv", m_pAllocCB);
+      gpuCuller.setBuffer(frameData.getBuffer());
+    }
+    catch (const std::runtime_error& e)
+    {
+      printf("GPU culling disabled: %s\n", e.what());
+      gpuCuller.destroy();
+      gpuCullingSupported = false;
+    }
+  }
+  gpuCullingEnabled = gpuCullingSupported;
 
-#ifndef USING_PUSH_CONSTANT
-  // Copy Model data
-  int numMeshes = 0;
-  for (size_t j = 0; j < modelList.size(); ++j)
+  // Meshlet commands are written in any number up to their group's room, only the count buffer says how many
+  clusterCullingSupported = gpuCullingSupported && indirectCountSupported;
+  if (clusterCullingSupported)
   {
-    for (size_t i = 0; i < modelList[j]->getMeshCount(); ++i)
+    try
+    {
+      clusterCuller.init(mainDevice.logicalDevice, "Shaders/cluster_cull.spv", m_pAllocCB);
+      clusterCuller.setBuffer(frameData.getBuffer());
+      clusterCuller.setMeshletBuffer(geometryArena.getMeshletBuffer());
+    }
+    catch (const std::runtime_error& e)
     {
-      Model* thisModel = (Model*)((uint64_t)modelTransferSpace + (i * modelUniformAlignment));
-      *thisModel = modelList[j]->getMesh(i)->getModel();
+      printf("Cluster culling disabled: %s\n", e.what());
+      clusterCuller.destroy();
+      clusterCullingSupported = false;
     }
-    numMeshes += modelList[j]->getMeshCount();
   }
-  vkMapMemory(mainDevice.logicalDevice,
-              modelUniformBufferMemoryDynamic[imageIndex],
-              0,
-              modelUniformAlignment * numMeshes,
-              0,
-              &data);
-  memcpy(data, modelTransferSpace, modelUniformAlignment * numMeshes);
-  vkUnmapMemory(mainDevice.logicalDevice, modelUniformBufferMemoryDynamic[imageIndex]);
-#endif
+  clusterCullingEnabled = clusterCullingSupported;
 }
 
-void VulkanRenderer::recordCommands(uint32_t currentImage)
+void VulkanRenderer::buildDrawList()
 {
-  VkCommandBufferBeginInfo beginInfo = {};
-  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-//  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;     // Buffer can be resubmitted when it has already been submitted and waiting execution
-
-  VkRenderPassBeginInfo renderBeginInfo = {};
-  renderBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-  renderBeginInfo.renderPass = renderPass;                            // Render pass to begin
-  renderBeginInfo.renderArea.offset = { 0, 0 };                       // Start point
-  renderBeginInfo.renderArea.extent = swapChainExtent;                // Region size
-
-  std::array<VkClearValue, 3> clearValues = {};
-  clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-  clearValues[1].color = { 0.6f, 0.65f, 0.4f, 1.0f };
-  clearValues[2].depthStencil.depth = 1.0f;
-
-  renderBeginInfo.pClearValues = clearValues.data();
-  renderBeginInfo.clearValueCount = clearValues.size();
+  bool cpuCulling = isCpuCullingActive();
 
-  renderBeginInfo.framebuffer = swapChainFramebuffers[currentImage];
-  auto& commandBuffer = commandBuffers[currentImage];
+  // World transforms of the nodes moved since the last frame
+  sceneGraph.update();
 
-  // Start recording commands to command buffer
-  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+  // Flatten the draws so they can be split evenly between threads
+  size_t drawCount = 0;
+  for (const auto& meshModel : modelList)
   {
-    throw std::runtime_error("Failed to begin command buffer");
+    drawCount += meshModel->getAsset()->getDrawCount();
   }
 
-  // Begin render pass
-  vkCmdBeginRenderPass(commandBuffer, &renderBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+  drawItems.clear();
+  drawItems.reserve(drawCount);
+  if (cpuCulling)
+  {
+    cpuCuller.resize(drawCount);
+  }
 
-  // Bind pipeline to use
-  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+  // An error of one model unit at distance one covers this many pixels, over the LOD pixel error.
+  // The projection is flipped for Vulkan, only the magnitude of its y scale matters.
+  float lodErrorScale = std::abs(uboViewProjection.projection[1][1]) * 0.5f * swapChainExtent.height / LOD_PIXEL_ERROR;
 
   for (size_t j = 0; j < modelList.size(); ++j)
   {
-    MeshModel* meshModel = modelList[j];
+    const MeshModel* meshModel = modelList[j];
+    const MeshAsset& asset = *meshModel->getAsset();
+    for (size_t n = 0; n < asset.getNodeCount(); ++n)
+    {
+      const MeshNode& node = asset.getNode(n);
+      if (node.meshCount == 0)
+      {
+        continue;
+      }
 
-    uint32_t* dynamicOffsetPtr = nullptr;
-#ifndef USING_PUSH_CONSTANT
-    // Dynamic offset amount
-    uint32_t dynamicOffset = static_cast<uint32_t>(modelUniformAlignment) * j;
-    dynamicOffsetPtr = &dynamicOffset;
-#else
-    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Model), &meshModel->getModelMatrix());
-#endif
+      uint32_t nodeIndex = meshModel->getSceneNode(n);
+      const glm::mat4& modelMatrix = sceneGraph.getWorldTransform(nodeIndex);
+      const glm::mat4 modelView = uboViewProjection.view * modelMatrix;
 
-    for (size_t k = 0; k < meshModel->getMeshCount(); ++k)
-    {
-      auto* mesh = meshModel->getMesh(k);
+      // Node origin distance from the camera, for front to back ordering
+      glm::vec4 viewPos = modelView[3];
 
-      VkBuffer vertexBuffers[] = { mesh->getVertexBuffer() };
-      VkDeviceSize offsets[] = { 0 };
-      vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+      // Bounds are scaled by the largest axis scale of the node
+      float scale = std::max(glm::length(glm::vec3(modelMatrix[0])),
+                             std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
 
-      if (mesh->getIndexCount() > 0)
+      for (uint32_t m = node.firstMesh; m < node.firstMesh + node.meshCount; ++m)
       {
-        // Bind mesh index buffer
-        vkCmdBindIndexBuffer(commandBuffer, mesh->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
-
-        std::array<VkDescriptorSet, 2> descriptorSetGroup =
+        uint32_t k = asset.getNodeMesh(m);
+        const Mesh* mesh = asset.getMesh(k);
+        const BoundingSphere& bounds = mesh->getBounds();
+
+        // Projected error shrinks with the distance to the closest point of the bounds
+        uint32_t lod = 0;
+        float distance = glm::length(glm::vec3(modelView * glm::vec4(bounds.center, 1.0f))) - bounds.radius * scale;
+        if (lodSelectionEnabled && distance > 0.0f)
         {
-          descriptorSets[currentImage],
-          samplerDescriptorSets[mesh->getTexId()]
-        };
+          for (lod = mesh->getLodCount() - 1; lod > 0; --lod)
+          {
+            if (mesh->getLod(lod).error * scale * lodErrorScale <= distance)
+            {
+              break;
+            }
+          }
+        }
 
-        // Bind descriptor sets for uniform buffers
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
-                                descriptorSetGroup.size(), descriptorSetGroup.data(), 0, dynamicOffsetPtr);
+        // Every mesh shares the geometry arena buffers, the mesh id and LOD keep its instances together.
+        // The index buffer changes with the index type, it goes in the most significant field.
+        uint32_t indexBuffer = mesh->getIndexType() == VK_INDEX_TYPE_UINT16 ? 0 : 1;
+        uint64_t key = RenderQueue::MakeKey(indexBuffer, mesh->getTexId(), mesh->getId() * MAX_MESH_LODS + lod, -viewPos.z);
 
-        // Execute pipeline
-        vkCmdDrawIndexed(commandBuffer, mesh->getIndexCount(), 1, 0, 0, 0);
-      }
-      else
-      {
-        // Execute pipeline
-        vkCmdDraw(commandBuffer, mesh->getVertexCount(), 1, 0, 0);
+        if (cpuCulling)
+        {
+          cpuCuller.setSphere(drawItems.size(), glm::vec3(modelMatrix * glm::vec4(bounds.center, 1.0f)), bounds.radius * scale);
+        }
+
+        drawItems.push_back({ static_cast<uint32_t>(j), k, nodeIndex, lod, key });
       }
     }
   }
 
+  // Only the visible draws are queued and sorted, the recording walks the queue
+  renderQueue.clear();
+  if (cpuCulling)
+  {
+    auto cullStart = std::chrono::high_resolution_clock::now();
+
+    glm::vec4 frustumPlanes[6];
+    getFrustumPlanes(uboViewProjection.projection * uboViewProjection.view, frustumPlanes);
+    cpuCuller.cull(frustumPlanes, visibleDraws);
+
+    cpuCullTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - cullStart).count();
+
+    for (uint32_t drawIndex : visibleDraws)
+    {
+      renderQueue.add(drawItems[drawIndex].key, drawIndex);
+    }
+  }
+  else
+  {
+    for (size_t i = 0; i < drawItems.size(); ++i)
+    {
+      renderQueue.add(drawItems[i].key, static_cast<uint32_t>(i));
+    }
+  }
+  renderQueue.sort();
+
+  // Consecutive draws of the same mesh and LOD become the instances of one draw, if the pipeline can fetch their transform
+  drawBatches.clear();
+  const Mesh* batchMesh = nullptr;
+  for (size_t i = 0; i < renderQueue.size(); ++i)
+  {
+    uint32_t drawIndex = renderQueue.getDrawIndex(i);
+    const Mesh* mesh = getDrawMesh(drawIndex);
+    uint32_t lod = drawItems[drawIndex].lod;
+    if (instancingSupported && mesh == batchMesh && lod == drawBatches.back().lod)
+    {
+      ++drawBatches.back().instanceCount;
+    }
+    else
+    {
+      drawBatches.push_back({ static_cast<uint32_t>(i), 1, lod });
+      batchMesh = mesh;
+    }
+  }
+}
+
+void VulkanRenderer::updateUniformBuffers()
+{
+  // Culling results of the previous use of this frame's partition are complete, its fence was waited on in draw()
+  if (visibleCountOffsets[currentFrame] != VK_WHOLE_SIZE)
+  {
+    gpuVisibleCount = *static_cast<const uint32_t*>(frameData.getMappedData(visibleCountOffsets[currentFrame]));
+    visibleCountOffsets[currentFrame] = VK_WHOLE_SIZE;
+  }
+
+  VkDeviceSize frameSize = frameData.alignSize(sizeof(UboViewProjection));
+  if (instancingSupported)
+  {
+    // Object data and instance indices
+    frameSize += frameData.alignSize(sizeof(ObjectData) * drawItems.size());
+    frameSize += frameData.alignSize(sizeof(uint32_t) * drawItems.size());
+  }
+  if (indirectDrawEnabled)
+  {
+    // Draw commands, the visible count and a draw count per group
+    frameSize += frameData.alignSize(sizeof(VkDrawIndexedIndirectCommand) * drawItems.size());
+    frameSize += frameData.alignSize(sizeof(uint32_t) * (drawItems.size() + 1));
+    if (isClusterCullingActive())
+    {
+      // Room for the meshlet commands and their instance indices
+      size_t clusterCommandCount = 0;
+      for (const auto& batch : drawBatches)
+      {
+        clusterCommandCount += getClusterCommandCount(batch);
+      }
+      frameSize += frameData.alignSize(sizeof(VkDrawIndexedIndirectCommand) * clusterCommandCount);
+      frameSize += frameData.alignSize(sizeof(uint32_t) * clusterCommandCount);
+      frameSize += frameData.alignSize(sizeof(ClusterCuller::ClusterDraw) * drawItems.size());
+    }
+    else if (isGpuCullingActive())
+    {
+      frameSize += frameData.alignSize(sizeof(GpuCuller::CullDraw) * drawItems.size());
+    }
+  }
+  if (frameSize > frameData.getFrameSize())
+  {
+    // Buffer is shared by all frames in flight, wait for them before replacing it
+    vkDeviceWaitIdle(mainDevice.logicalDevice);
+    frameData.resize(std::max(frameSize, frameData.getFrameSize() * 2));
+    writeDescriptorSet();
+    if (gpuCullingSupported)
+    {
+      gpuCuller.setBuffer(frameData.getBuffer());
+    }
+    if (clusterCullingSupported)
+    {
+      clusterCuller.setBuffer(frameData.getBuffer());
+    }
+    visibleCountOffsets.fill(VK_WHOLE_SIZE);
+  }
+
+  // Partition of this frame is free, its fence was waited on in draw()
+  frameData.beginFrame(currentFrame);
+
+  // Copy VP data
+  void* data;
+  vpUniformOffset = static_cast<uint32_t>(frameData.allocate(sizeof(UboViewProjection), &data));
+  memcpy(data, &uboViewProjection, sizeof(UboViewProjection));
+
+  // Copy object data in render queue order, so the instances of a batch are contiguous
+  objectDataOffset = 0;
+  instanceIndicesOffset = 0;
+  size_t queuedDrawCount = renderQueue.size();
+  if (instancingSupported && queuedDrawCount > 0)
+  {
+    objectDataOffset = static_cast<uint32_t>(frameData.allocate(sizeof(ObjectData) * queuedDrawCount, &data));
+    ObjectData* objects = static_cast<ObjectData*>(data);
+    for (size_t i = 0; i < queuedDrawCount; ++i)
+    {
+      uint32_t drawIndex = renderQueue.getDrawIndex(i);
+      const Mesh* mesh = getDrawMesh(drawIndex);
+      objects[i].model = sceneGraph.getWorldTransform(drawItems[drawIndex].nodeIndex);
+      objects[i].positionScale = glm::vec4(mesh->getPositionScale(), 1.0f);
+      objects[i].positionBias = glm::vec4(mesh->getPositionBias(), 0.0f);
+      objects[i].textureIndex = getTextureDescriptor(mesh->getTexId());
+    }
+
+    // Every instance draws its own object, the culling pass rewrites the slots of the batches it culls
+    instanceIndicesOffset = static_cast<uint32_t>(frameData.allocate(sizeof(uint32_t) * queuedDrawCount, &data));
+    uint32_t* instanceIndices = static_cast<uint32_t*>(data);
+    for (size_t i = 0; i < queuedDrawCount; ++i)
+    {
+      instanceIndices[i] = static_cast<uint32_t>(i);
+    }
+
+    if (indirectDrawEnabled)
+    {
+      writeIndirectCommands();
+    }
+  }
+}
+
+void VulkanRenderer::writeIndirectCommands()
+{
+  // Group the sorted batches by texture and index type, one indirect draw per group.
+  // The texture array is indexed in the shader, a single group per index type then draws every batch.
+  indirectGroups.clear();
+  nonIndexedBatches.clear();
+  size_t batchCount = drawBatches.size();
+  for (size_t i = 0; i < batchCount; ++i)
+  {
+    const Mesh* mesh = getBatchMesh(drawBatches[i]);
+    int texId = bindlessTexturesSupported ? 0 : getTextureDescriptor(mesh->getTexId());
+    if (indirectGroups.empty() || indirectGroups.back().texId != texId || indirectGroups.back().indexType != mesh->getIndexType())
+    {
+      IndirectGroup group = {};
+      group.texId = texId;
+      group.indexType = mesh->getIndexType();
+      group.firstBatch = static_cast<uint32_t>(i);
+      group.firstNonIndexedBatch = static_cast<uint32_t>(nonIndexedBatches.size());
+      indirectGroups.push_back(group);
+    }
+
+    IndirectGroup& group = indirectGroups.back();
+    ++group.batchCount;
+
+    // Meshes without indices can't be part of an indexed indirect draw, their command draws nothing
+    if (mesh->getIndexCount() == 0)
+    {
+      nonIndexedBatches.push_back(static_cast<uint32_t>(i));
+      ++group.nonIndexedBatchCount;
+    }
+  }
+
+  // A command per batch, or room for a command per meshlet of every instance when clusters are culled
+  bool clusterCulling = isClusterCullingActive();
+  uint32_t commandCount = 0;
+  for (auto& group : indirectGroups)
+  {
+    group.firstCommand = commandCount;
+    group.commandCount = group.batchCount;
+    if (clusterCulling)
+    {
+      group.commandCount = 0;
+      for (uint32_t i = group.firstBatch; i < group.firstBatch + group.batchCount; ++i)
+      {
+        group.commandCount += getClusterCommandCount(drawBatches[i]);
+      }
+    }
+    commandCount += group.commandCount;
+  }
+
+  void* data;
+  indirectCommandsOffset = static_cast<uint32_t>(frameData.allocate(sizeof(VkDrawIndexedIndirectCommand) * commandCount, &data));
+  VkDrawIndexedIndirectCommand* commands = static_cast<VkDrawIndexedIndirectCommand*>(data);
+
+  // Visible count, then the draw count of each group
+  indirectCountsOffset = static_cast<uint32_t>(frameData.allocate(sizeof(uint32_t) * (indirectGroups.size() + 1), &data));
+  uint32_t* counts = static_cast<uint32_t*>(data);
+
+  if (clusterCulling)
+  {
+    // Culling pass writes every command drawn and its instance index, the groups start empty
+    cullDrawCount = 0;
+    cullDrawsOffset = static_cast<uint32_t>(frameData.allocate(sizeof(ClusterCuller::ClusterDraw) * renderQueue.size(), &data));
+    ClusterCuller::ClusterDraw* clusterDraws = static_cast<ClusterCuller::ClusterDraw*>(data);
+
+    for (uint32_t groupIndex = 0; groupIndex < indirectGroups.size(); ++groupIndex)
+    {
+      const IndirectGroup& group = indirectGroups[groupIndex];
+      for (uint32_t batchIndex = group.firstBatch; batchIndex < group.firstBatch + group.batchCount; ++batchIndex)
+      {
+        const DrawBatch& batch = drawBatches[batchIndex];
+        const Mesh* mesh = getBatchMesh(batch);
+        if (mesh->getIndexCount() == 0)
+        {
+          continue;
+        }
+
+        const MeshLod& lod = mesh->getLod(batch.lod);
+        const BoundingSphere& bounds = mesh->getBounds();
+        for (uint32_t i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount; ++i)
+        {
+          ClusterCuller::ClusterDraw& clusterDraw = clusterDraws[cullDrawCount++];
+          clusterDraw.sphere = glm::vec4(bounds.center, bounds.radius);
+          clusterDraw.objectIndex = i;
+          clusterDraw.firstMeshlet = mesh->getFirstMeshlet();
+          clusterDraw.meshletCount = batch.lod == 0 ? mesh->getMeshletCount() : 0;
+          clusterDraw.firstIndex = lod.firstIndex;
+          clusterDraw.indexCount = lod.indexCount;
+          clusterDraw.vertexOffset = mesh->getVertexOffset();
+          clusterDraw.groupIndex = groupIndex;
+          clusterDraw.firstCommand = group.firstCommand;
+        }
+      }
+
+      counts[groupIndex + 1] = 0;
+    }
+
+    // Commands are indexed by their first instance, the per batch instance slots aren't used
+    instanceIndicesOffset = static_cast<uint32_t>(frameData.allocate(sizeof(uint32_t) * commandCount, &data));
+
+    counts[0] = 0;
+    visibleCountOffsets[currentFrame] = indirectCountsOffset;
+    return;
+  }
+
+  // One command per batch, firstInstance is the first slot of its instance indices.
+  // The culling pass adds the visible instances to the commands, which start empty.
+  bool gpuCulling = isGpuCullingActive();
+  for (size_t i = 0; i < batchCount; ++i)
+  {
+    const DrawBatch& batch = drawBatches[i];
+    const Mesh* mesh = getBatchMesh(batch);
+
+    const MeshLod& lod = mesh->getLod(batch.lod);
+
+    VkDrawIndexedIndirectCommand& command = commands[i];
+    command.indexCount = lod.indexCount;
+    command.instanceCount = lod.indexCount > 0 && !gpuCulling ? batch.instanceCount : 0;
+    command.firstIndex = lod.firstIndex;
+    command.vertexOffset = mesh->getVertexOffset();
+    command.firstInstance = batch.firstInstance;
+  }
+
+  counts[0] = static_cast<uint32_t>(renderQueue.size());
+  for (size_t groupIndex = 0; groupIndex < indirectGroups.size(); ++groupIndex)
+  {
+    counts[groupIndex + 1] = indirectGroups[groupIndex].commandCount;
+  }
+
+  if (gpuCulling)
+  {
+    // Culling pass tests every instance of the indexed batches, it only needs the bounds
+    cullDrawCount = 0;
+    cullDrawsOffset = static_cast<uint32_t>(frameData.allocate(sizeof(GpuCuller::CullDraw) * renderQueue.size(), &data));
+    GpuCuller::CullDraw* cullDraws = static_cast<GpuCuller::CullDraw*>(data);
+
+    for (uint32_t batchIndex = 0; batchIndex < batchCount; ++batchIndex)
+    {
+      const DrawBatch& batch = drawBatches[batchIndex];
+      const Mesh* mesh = getBatchMesh(batch);
+      if (mesh->getIndexCount() == 0)
+      {
+        continue;
+      }
+
+      const BoundingSphere& bounds = mesh->getBounds();
+      for (uint32_t i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount; ++i)
+      {
+        GpuCuller::CullDraw& cullDraw = cullDraws[cullDrawCount++];
+        cullDraw.sphere = glm::vec4(bounds.center, bounds.radius);
+        cullDraw.objectIndex = i;
+        cullDraw.batchIndex = batchIndex;
+        cullDraw.batchFirstInstance = batch.firstInstance;
+        cullDraw.padding = 0;
+      }
+    }
+
+    counts[0] = 0;
+    visibleCountOffsets[currentFrame] = indirectCountsOffset;
+  }
+}
+
+uint32_t VulkanRenderer::getClusterCommandCount(const DrawBatch& batch) const
+{
+  // A command per meshlet of each instance, a single one for the coarser LODs which have none
+  const Mesh* mesh = getBatchMesh(batch);
+  if (mesh->getIndexCount() == 0)
+  {
+    return 0;
+  }
+
+  uint32_t commandsPerInstance = batch.lod == 0 && mesh->getMeshletCount() > 0 ? mesh->getMeshletCount() : 1;
+  return commandsPerInstance * batch.instanceCount;
+}
+
+void VulkanRenderer::recordCommands(uint32_t currentImage)
+{
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+//  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;     // Buffer can be resubmitted when it has already been submitted and waiting execution
+
+  VkRenderPassBeginInfo renderBeginInfo = {};
+  renderBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderBeginInfo.renderPass = renderPass;                            // Render pass to begin
+  renderBeginInfo.renderArea.offset = { 0, 0 };                       // Start point
+  renderBeginInfo.renderArea.extent = swapChainExtent;                // Region size
+
+  std::array<VkClearValue, 3> clearValues = {};
+  clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+  clearValues[1].color = { 0.6f, 0.65f, 0.4f, 1.0f };
+  clearValues[2].depthStencil.depth = 1.0f;
+
+  renderBeginInfo.pClearValues = clearValues.data();
+  renderBeginInfo.clearValueCount = clearValues.size();
+
+  renderBeginInfo.framebuffer = swapChainFramebuffers[currentImage];
+  auto& commandBuffer = commandBuffers[currentImage];
+
+  // Start recording commands to command buffer
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to begin command buffer");
+  }
+
+  // Culling pass writes the indirect commands read by the first subpass
+  if (isGpuCullingActive() && cullDrawCount > 0)
+  {
+    glm::vec4 frustumPlanes[6];
+    getFrustumPlanes(uboViewProjection.projection * uboViewProjection.view, frustumPlanes);
+
+    if (isClusterCullingActive())
+    {
+      glm::vec3 eye = glm::vec3(glm::inverse(uboViewProjection.view)[3]);
+      clusterCuller.record(commandBuffer, frustumPlanes, eye, cullDrawCount,
+                           objectDataOffset, cullDrawsOffset, indirectCommandsOffset, indirectCountsOffset, instanceIndicesOffset);
+    }
+    else
+    {
+      gpuCuller.record(commandBuffer, frustumPlanes, cullDrawCount,
+                       objectDataOffset, cullDrawsOffset, indirectCommandsOffset, indirectCountsOffset, instanceIndicesOffset);
+    }
+  }
+
+  // Begin render pass, the first subpass only executes secondary command buffers
+  vkCmdBeginRenderPass(commandBuffer, &renderBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+  uint32_t threadCount = threadPool.getThreadCount();
+  size_t queuedDrawCount = renderQueue.size();
+  size_t batchCount = drawBatches.size();
+  size_t chunkCount = std::min<size_t>(threadCount, (batchCount + MIN_DRAWS_PER_CHUNK - 1) / MIN_DRAWS_PER_CHUNK);
+  size_t chunkSize = chunkCount > 0 ? (batchCount + chunkCount - 1) / chunkCount : 0;
+
+  // Indirect draws cost the same to record whatever the draw count, a single thread is enough
+  if (indirectDrawEnabled)
+  {
+    chunkCount = batchCount > 0 ? 1 : 0;
+  }
+
+  chunkStats.assign(chunkCount, FrameStats());
+
+  VkCommandBufferInheritanceInfo inheritanceInfo = {};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = renderPass;
+  inheritanceInfo.subpass = 0;
+  inheritanceInfo.framebuffer = swapChainFramebuffers[currentImage];
+
+  // This frame's fence was waited on, nothing recorded from its pools is still in use
+  VkCommandPool* framePools = &secondaryCommandPools[currentFrame * threadCount];
+  VkCommandBuffer* frameCommandBuffers = &secondaryCommandBuffers[currentFrame * threadCount];
+
+  if (indirectDrawEnabled)
+  {
+    if (chunkCount > 0)
+    {
+      vkResetCommandPool(mainDevice.logicalDevice, framePools[0], 0);
+      recordIndirectCommands(frameCommandBuffers[0], inheritanceInfo, chunkStats[0]);
+    }
+  }
+  else
+  {
+    threadPool.parallelFor(static_cast<uint32_t>(chunkCount), [&](uint32_t chunk)
+    {
+      vkResetCommandPool(mainDevice.logicalDevice, framePools[chunk], 0);
+
+      size_t firstBatch = chunk * chunkSize;
+      recordSecondaryCommands(frameCommandBuffers[chunk], inheritanceInfo, firstBatch,
+                              std::min(chunkSize, batchCount - firstBatch), chunkStats[chunk]);
+    });
+  }
+
+  frameStats = FrameStats();
+  for (const auto& stats : chunkStats)
+  {
+    frameStats.drawCalls += stats.drawCalls;
+    frameStats.bindCount += stats.bindCount;
+    frameStats.bindsSkipped += stats.bindsSkipped;
+    frameStats.triangleCount += stats.triangleCount;
+  }
+
+  // Chunks only get the draws left after CPU culling
+  frameStats.drawCount = static_cast<uint32_t>(drawItems.size());
+  if (isGpuCullingActive())
+  {
+    frameStats.visibleCount = std::min(gpuVisibleCount, frameStats.drawCount);
+  }
+  else
+  {
+    frameStats.visibleCount = static_cast<uint32_t>(queuedDrawCount);
+  }
+  frameStats.cpuCullTime = isCpuCullingActive() ? cpuCullTime : 0.0f;
+
+  if (chunkCount > 0)
+  {
+    vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(chunkCount), frameCommandBuffers);
+  }
+
   // Start second subpass
   vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
 
@@ -1491,6 +2164,211 @@ void VulkanRenderer::recordCommands(uint32_t currentImage)
   }
 }
 
+void VulkanRenderer::recordSecondaryCommands(VkCommandBuffer commandBuffer,
+                                             const VkCommandBufferInheritanceInfo& inheritanceInfo,
+                                             size_t firstBatch,
+                                             size_t batchCount,
+                                             FrameStats& stats)
+{
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to begin secondary command buffer");
+  }
+
+  // State isn't inherited from the primary command buffer.
+  // Instanced pipeline reads the transforms from the object data, otherwise each draw has a single instance.
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, instancingSupported ? instancedPipeline : graphicsPipeline);
+
+  // Geometry of every mesh is in the arena, draws select theirs with offsets
+  VkBuffer vertexBuffer = geometryArena.getVertexBuffer();
+  VkDeviceSize vertexBufferOffset = 0;
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &vertexBufferOffset);
+  stats.bindCount += 2;
+
+  // Currently bound state, draws are sorted so only what differs from the previous draw is bound
+  uint32_t boundNodeIndex = ~0u;
+  const Mesh* boundMesh = nullptr;
+  int boundTexId = -1;
+  bool indexBufferBound = false;
+  VkIndexType boundIndexType = VK_INDEX_TYPE_UINT32;
+  bool uniformSetBound = false;
+
+  auto countBind = [&stats](bool needed)
+  {
+    if (needed)
+    {
+      ++stats.bindCount;
+    }
+    else
+    {
+      ++stats.bindsSkipped;
+    }
+    return needed;
+  };
+
+  for (size_t i = firstBatch; i < firstBatch + batchCount; ++i)
+  {
+    const DrawBatch& batch = drawBatches[i];
+    uint32_t drawIndex = renderQueue.getDrawIndex(batch.firstInstance);
+    const DrawItem& drawItem = drawItems[drawIndex];
+    MeshModel* meshModel = modelList[drawItem.modelIndex];
+    auto* mesh = meshModel->getMesh(drawItem.meshIndex);
+
+    // Transform only changes between draws without the instanced pipeline, with every mesh when vertices are packed
+    bool modelChanged = !instancingSupported &&
+                        (drawItem.nodeIndex != boundNodeIndex || (vertexFormat == VertexFormat::Packed && mesh != boundMesh));
+    boundNodeIndex = drawItem.nodeIndex;
+    boundMesh = mesh;
+
+    if (countBind(modelChanged))
+    {
+      const glm::mat4 transform = getDrawTransform(drawIndex);
+      vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Model), &transform);
+    }
+
+    // Dynamic offsets of this frame's uniforms are the same for every draw
+    bool uniformSetChanged = !uniformSetBound;
+    std::array<uint32_t, 3> dynamicOffsets = { vpUniformOffset, objectDataOffset, instanceIndicesOffset };
+    if (countBind(uniformSetChanged))
+    {
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
+                              1, &descriptorSet, dynamicOffsets.size(), dynamicOffsets.data());
+      uniformSetBound = true;
+    }
+
+    // Texture array is bound once for every draw
+    int texId = bindlessTexturesSupported ? 0 : getTextureDescriptor(mesh->getTexId());
+    if (countBind(texId != boundTexId))
+    {
+      boundTexId = texId;
+      VkDescriptorSet textureSet = getTextureDescriptorSet(boundTexId);
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1,
+                              1, &textureSet, 0, nullptr);
+    }
+
+    // Instance indices of the batch start at its first render queue entry
+    if (mesh->getIndexCount() > 0)
+    {
+      // Arena has an index buffer per index type
+      if (countBind(!indexBufferBound || mesh->getIndexType() != boundIndexType))
+      {
+        boundIndexType = mesh->getIndexType();
+        indexBufferBound = true;
+        vkCmdBindIndexBuffer(commandBuffer, geometryArena.getIndexBuffer(boundIndexType), 0, boundIndexType);
+      }
+
+      // Execute pipeline
+      const MeshLod& lod = mesh->getLod(batch.lod);
+      vkCmdDrawIndexed(commandBuffer, lod.indexCount, batch.instanceCount, lod.firstIndex, mesh->getVertexOffset(), batch.firstInstance);
+      stats.triangleCount += static_cast<uint64_t>(lod.indexCount / 3) * batch.instanceCount;
+    }
+    else
+    {
+      // Execute pipeline
+      vkCmdDraw(commandBuffer, mesh->getVertexCount(), batch.instanceCount, mesh->getVertexOffset(), batch.firstInstance);
+      stats.triangleCount += static_cast<uint64_t>(mesh->getVertexCount() / 3) * batch.instanceCount;
+    }
+    ++stats.drawCalls;
+  }
+
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to end secondary command buffer");
+  }
+}
+
+void VulkanRenderer::recordIndirectCommands(VkCommandBuffer commandBuffer,
+                                            const VkCommandBufferInheritanceInfo& inheritanceInfo,
+                                            FrameStats& stats)
+{
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to begin indirect command buffer");
+  }
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, instancedPipeline);
+
+  VkBuffer vertexBuffer = geometryArena.getVertexBuffer();
+  VkDeviceSize vertexBufferOffset = 0;
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &vertexBufferOffset);
+
+  std::array<uint32_t, 3> dynamicOffsets = { vpUniformOffset, objectDataOffset, instanceIndicesOffset };
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
+                          1, &descriptorSet, dynamicOffsets.size(), dynamicOffsets.data());
+  stats.bindCount += 3;
+
+  // Groups sharing a texture differ by their index type, only what changes is bound
+  int boundTexId = -1;
+  bool indexBufferBound = false;
+  VkIndexType boundIndexType = VK_INDEX_TYPE_UINT32;
+
+  VkBuffer buffer = frameData.getBuffer();
+  for (size_t groupIndex = 0; groupIndex < indirectGroups.size(); ++groupIndex)
+  {
+    const IndirectGroup& group = indirectGroups[groupIndex];
+
+    if (group.texId != boundTexId)
+    {
+      boundTexId = group.texId;
+      VkDescriptorSet textureSet = getTextureDescriptorSet(boundTexId);
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1,
+                              1, &textureSet, 0, nullptr);
+      ++stats.bindCount;
+    }
+
+    if (!indexBufferBound || group.indexType != boundIndexType)
+    {
+      boundIndexType = group.indexType;
+      indexBufferBound = true;
+      vkCmdBindIndexBuffer(commandBuffer, geometryArena.getIndexBuffer(boundIndexType), 0, boundIndexType);
+      ++stats.bindCount;
+    }
+
+    VkDeviceSize commandsOffset = indirectCommandsOffset + sizeof(VkDrawIndexedIndirectCommand) * group.firstCommand;
+    if (indirectCountSupported)
+    {
+      // Count written in the buffer, by the culling pass when it runs
+      VkDeviceSize countOffset = indirectCountsOffset + sizeof(uint32_t) * (groupIndex + 1);
+      pfnCmdDrawIndexedIndirectCount(commandBuffer, buffer, commandsOffset, buffer, countOffset,
+                                     group.commandCount, sizeof(VkDrawIndexedIndirectCommand));
+    }
+    else
+    {
+      vkCmdDrawIndexedIndirect(commandBuffer, buffer, commandsOffset, group.commandCount, sizeof(VkDrawIndexedIndirectCommand));
+    }
+    ++stats.drawCalls;
+
+    for (uint32_t i = group.firstBatch; i < group.firstBatch + group.batchCount; ++i)
+    {
+      stats.triangleCount += static_cast<uint64_t>(getBatchLod(drawBatches[i]).indexCount / 3) * drawBatches[i].instanceCount;
+    }
+
+    for (uint32_t i = group.firstNonIndexedBatch; i < group.firstNonIndexedBatch + group.nonIndexedBatchCount; ++i)
+    {
+      const DrawBatch& batch = drawBatches[nonIndexedBatches[i]];
+      const Mesh* mesh = getBatchMesh(batch);
+      vkCmdDraw(commandBuffer, mesh->getVertexCount(), batch.instanceCount, mesh->getVertexOffset(), batch.firstInstance);
+      stats.triangleCount += static_cast<uint64_t>(mesh->getVertexCount() / 3) * batch.instanceCount;
+      ++stats.drawCalls;
+    }
+  }
+
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+  {
+    throw std::runtime_error("Failed to end indirect command buffer");
+  }
+}
+
 void VulkanRenderer::getPhysicalDevice()
 {
   // Enumerate physical devices the vkInstance can access
@@ -1521,16 +2399,53 @@ void VulkanRenderer::getPhysicalDevice()
   vkGetPhysicalDeviceProperties(mainDevice.physicalDevice, &deviceProperties);
 
   minUniformBufferOffset = deviceProperties.limits.minUniformBufferOffsetAlignment;
-}
+  minStorageBufferOffset = deviceProperties.limits.minStorageBufferOffsetAlignment;
 
-void VulkanRenderer::allocateDynamicBufferTransferSpace()
-{
-#ifndef USING_PUSH_CONSTANT
-  modelUniformAlignment = static_cast<size_t>((sizeof(Model) + minUniformBufferOffset - 1) & (~(minUniformBufferOffset - 1)));
+  // Optional, lets the draw count of indirect draws come from a buffer
+  indirectCountSupported = indirectDrawSupported && hasDeviceExtension(mainDevice.physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
 
-  // Create space in memory to hold dynamic buffer that is aligned to our required alignment
-  modelTransferSpace = reinterpret_cast<Model*>(_aligned_malloc(modelUniformAlignment * MAX_OBJECTS, modelUniformAlignment));
-#endif
+  // Optional, textures are indexed from a single sampler array instead of binding a set per texture
+  bindlessTexturesSupported = false;
+  if (hasDeviceExtension(mainDevice.physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+  {
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &indexingFeatures;
+    vkGetPhysicalDeviceFeatures2(mainDevice.physicalDevice, &features);
+
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &indexingProperties;
+    vkGetPhysicalDeviceProperties2(mainDevice.physicalDevice, &properties);
+
+    textureArraySize = std::min<uint32_t>({ static_cast<uint32_t>(MAX_BINDLESS_TEXTURES),
+                                            indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers,
+                                            indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                            indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+                                            indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages });
+
+    bindlessTexturesSupported = indexingFeatures.shaderSampledImageArrayNonUniformIndexing == VK_TRUE &&
+                                indexingFeatures.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE &&
+                                indexingFeatures.descriptorBindingPartiallyBound == VK_TRUE &&
+                                indexingFeatures.descriptorBindingUpdateUnusedWhilePending == VK_TRUE &&
+                                indexingFeatures.runtimeDescriptorArray == VK_TRUE &&
+                                textureArraySize > 0;
+  }
+
+  // Culling pass is recorded in the same command buffer as the draws, the graphics queue must support compute
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(mainDevice.physicalDevice, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilyList(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(mainDevice.physicalDevice, &queueFamilyCount, queueFamilyList.data());
+
+  QueueFamilyIndices indices = getQueueFamilies(mainDevice.physicalDevice);
+  gpuCullingSupported = indirectDrawSupported && (queueFamilyList[indices.graphicsFamily].queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
 }
 
 bool VulkanRenderer::checkInstanceExtensionSupport(const std::vector<const char*>& a_rExtensions)
@@ -1601,6 +2516,25 @@ bool VulkanRenderer::checkDeviceExtensionSupport(VkPhysicalDevice device)
   return true;
 }
 
+bool VulkanRenderer::hasDeviceExtension(VkPhysicalDevice device, const char* extensionName)
+{
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+  for (const auto& extension : extensions)
+  {
+    if (strcmp(extensionName, extension.extensionName) == 0)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 bool VulkanRenderer::checkValidationLayerSupport()
 {
   if (m_bValidationLayers)
@@ -1667,6 +2601,19 @@ bool VulkanRenderer::checkSuitableDevice(VkPhysicalDevice device)
   }
 
   samplerAnisotropySupported = deviceFeatures.samplerAnisotropy == VK_TRUE;
+  compressedTexturesSupported = deviceFeatures.textureCompressionBC == VK_TRUE;
+
+  // Attribute formats of the packed vertices
+  compactVerticesSupported = true;
+  for (VkFormat format : { VK_FORMAT_R16G16B16A16_UNORM, VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R16G16_SFLOAT })
+  {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(device, format, &properties);
+    compactVerticesSupported = compactVerticesSupported && (properties.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) != 0;
+  }
+
+  // Several draws per indirect call, each with its own draw index in firstInstance
+  indirectDrawSupported = deviceFeatures.multiDrawIndirect == VK_TRUE && deviceFeatures.drawIndirectFirstInstance == VK_TRUE;
 
   return indices.isValid() && swapChainValid;
 }
@@ -1707,6 +2654,19 @@ QueueFamilyIndices VulkanRenderer::getQueueFamilies(VkPhysicalDevice device)
     i++;
   }
 
+  // Transfer only families are usually backed by DMA engines, copies there run alongside the rendering
+  indices.transferFamily = indices.graphicsFamily;
+  for (uint32_t family = 0; family < queueFamilyList.size(); ++family)
+  {
+    VkQueueFlags flags = queueFamilyList[family].queueFlags;
+    if (queueFamilyList[family].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) != 0 &&
+        (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0)
+    {
+      indices.transferFamily = static_cast<int>(family);
+      break;
+    }
+  }
+
   return indices;
 }
 
@@ -1815,18 +2775,18 @@ VkFormat VulkanRenderer::chooseSupportedFormat(const std::vector<VkFormat>& form
   return VK_FORMAT_UNDEFINED;
 }
 
-std::tuple<VkImage, VkDeviceMemory> VulkanRenderer::createImage(uint32_t width,
-                                                                uint32_t height,
-                                                                VkFormat format,
-                                                                VkImageTiling tiling,
-                                                                VkImageUsageFlags useFlags,
-                                                                VkMemoryPropertyFlags propFlags)
+std::tuple<VkImage, DeviceAllocation> VulkanRenderer::createImage(uint32_t width,
+                                                                  uint32_t height,
+                                                                  VkFormat format,
+                                                                  VkImageTiling tiling,
+                                                                  VkImageUsageFlags useFlags,
+                                                                  VkMemoryPropertyFlags propFlags,
+                                                                  uint32_t mipLevels)
 {
   if (width == 0 || height == 0)
   {
     VkImage image = VK_NULL_HANDLE;
-    VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
-    return std::make_tuple(image, deviceMemory);
+    return std::make_tuple(image, DeviceAllocation());
   }
 
   // Create image
@@ -1836,7 +2796,7 @@ std::tuple<VkImage, VkDeviceMemory> VulkanRenderer::createImage(uint32_t width,
   imageCreateInfo.extent.width = width;
   imageCreateInfo.extent.height = height;
   imageCreateInfo.extent.depth = 1;
-  imageCreateInfo.mipLevels = 1;
+  imageCreateInfo.mipLevels = mipLevels;
   imageCreateInfo.arrayLayers = 1;
   imageCreateInfo.format = format;
   imageCreateInfo.tiling = tiling;
@@ -1851,27 +2811,13 @@ std::tuple<VkImage, VkDeviceMemory> VulkanRenderer::createImage(uint32_t width,
     throw std::runtime_error("Failed to create image");
   }
 
-  // Allocate device memory
-  VkMemoryRequirements memoryReqs = {};
-  vkGetImageMemoryRequirements(mainDevice.logicalDevice, image, &memoryReqs);
-
-  VkDeviceMemory deviceMemory;
-  VkMemoryAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memoryReqs.size;
-  allocInfo.memoryTypeIndex = findMemoryTypeIndex(mainDevice.physicalDevice, memoryReqs.memoryTypeBits, propFlags);
-  if (vkAllocateMemory(mainDevice.logicalDevice, &allocInfo, m_pAllocCB, &deviceMemory) != VK_SUCCESS)
-  {
-    throw std::runtime_error("Failed to allocate image device memory");
-  }
-
-  // Connect device memory to image
-  vkBindImageMemory(mainDevice.logicalDevice, image, deviceMemory, 0);
+  // Sub-allocate device memory and connect it to image
+  DeviceAllocation deviceMemory = deviceAllocator.allocateImage(image, tiling, propFlags);
 
   return std::make_tuple(image, deviceMemory);
 }
 
-VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
+VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels)
 {
   VkImageViewCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -1886,7 +2832,7 @@ VkImageView VulkanRenderer::createImageView(VkImage image, VkFormat format, VkIm
   // Subresources
   createInfo.subresourceRange.aspectMask = aspectFlags;         // COLOR_BIT for viewing color
   createInfo.subresourceRange.baseMipLevel = 0;                 // Start mipmap level
-  createInfo.subresourceRange.levelCount = 1;                   // Number of mipmap levels to view
+  createInfo.subresourceRange.levelCount = mipLevels;           // Number of mipmap levels to view
   createInfo.subresourceRange.baseArrayLayer = 0;               // Texture array index
   createInfo.subresourceRange.layerCount = 1;
 
@@ -1910,92 +2856,268 @@ VkShaderModule VulkanRenderer::createShaderModule(const std::vector<char>& code)
   return shaderModule;
 }
 
-int VulkanRenderer::createTextureImage(const std::string& filename)
+int VulkanRenderer::createTextureImage(const std::string& filename, uint32_t& mipLevels)
 {
   int width, height;
   VkDeviceSize imageSize;
   stbi_uc* imageData = loadTextureFile(filename, width, height, imageSize);
 
+  MipChain mips;
+  mips.build(imageData, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+  mipLevels = mips.getLevelCount();
+
+  stbi_image_free(imageData);
+  imageData = nullptr;
+
   VkBuffer imageStageBuffer;
-  VkDeviceMemory imageStageBufferMemory;
-  createBuffer(mainDevice.physicalDevice,
-               mainDevice.logicalDevice,
-               imageSize,
+  DeviceAllocation imageStageBufferMemory;
+  createBuffer(mainDevice.logicalDevice,
+               deviceAllocator,
+               mips.getSize(),
                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                &imageStageBuffer,
                &imageStageBufferMemory,
-               m_pAllocCB);
+               m_pAllocCB,
+               AllocationStrategy::Linear);
 
-  void* data;
-  vkMapMemory(mainDevice.logicalDevice, imageStageBufferMemory, 0, imageSize, 0, &data);
-  memcpy(data, imageData, static_cast<size_t>(imageSize));
-  vkUnmapMemory(mainDevice.logicalDevice, imageStageBufferMemory);
-
-  stbi_image_free(imageData);
-  imageData = nullptr;
+  memcpy(imageStageBufferMemory.mappedData, mips.getData(), mips.getSize());
 
   VkImage texImage;
-  VkDeviceMemory texImageMemory;
+  DeviceAllocation texImageMemory;
   std::tie(texImage, texImageMemory) = createImage(width,
                                                    height,
                                                    VK_FORMAT_R8G8B8A8_UNORM,
                                                    VK_IMAGE_TILING_OPTIMAL,
                                                    VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                   mipLevels);
 
   // Transition image to be DST for copy operation
-  transitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, texImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  transitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, texImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
 
-  // Copy image data
-  copyImageBuffer(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, imageStageBuffer, texImage, width, height);
+  // Copy image data, one level at a time
+  for (uint32_t level = 0; level < mipLevels; ++level)
+  {
+    const MipChain::Level& mip = mips.getLevel(level);
+    copyImageBuffer(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, imageStageBuffer, texImage,
+                    mip.width, mip.height, mip.offset, level);
+  }
 
-  transitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, texImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  transitionImageLayout(mainDevice.logicalDevice, graphicsQueue, graphicsCommandPool, texImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
 
   textureImages.push_back(texImage);
   textureImageMemory.push_back(texImageMemory);
 
   // Destroy staging buffers
   vkDestroyBuffer(mainDevice.logicalDevice, imageStageBuffer, m_pAllocCB);
-  vkFreeMemory(mainDevice.logicalDevice, imageStageBufferMemory, m_pAllocCB);
+  deviceAllocator.free(imageStageBufferMemory);
 
   return textureImages.size() - 1;
 }
 
-int VulkanRenderer::createTexture(const std::string& filename)
+int VulkanRenderer::loadTexture(const std::string& filename)
 {
-  int textureImageLoc = createTextureImage(filename);
+  uint32_t mipLevels;
+  int textureImageLoc = createTextureImage(filename, mipLevels);
 
-  VkImageView imageView = createImageView(textureImages[textureImageLoc], VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+  VkImageView imageView = createImageView(textureImages[textureImageLoc], VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
   textureImageViews.push_back(imageView);
 
   // Create descriptor set
   return createTextureDescriptor(imageView);
 }
 
-int VulkanRenderer::createTextureDescriptor(VkImageView textureImage)
+int VulkanRenderer::createTexture(const std::string& filename, std::vector<TextureStreamer::Request>& requests)
+{
+  // Read here to hash the content, the workers decode these bytes instead of reading the file again.
+  // A texture baked by the AssetBaker since the image last changed is uploaded as it is.
+  std::string fileLoc = "Textures/" + filename;
+  if (compressedTexturesSupported && isBakedTextureCurrent(fileLoc))
+  {
+    fileLoc += ".baked";
+  }
+  std::ifstream file(fileLoc, std::ios::binary);
+  std::vector<unsigned char> fileData((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (fileData.empty())
+  {
+    // Draws keep the placeholder
+    printf("Warning: failed to load texture file %s\n", filename.c_str());
+    return 0;
+  }
+
+  // Different relative paths to the same file give the same key
+  std::error_code error;
+  std::string canonicalPath = std::filesystem::weakly_canonical(fileLoc, error).string();
+  if (error)
+  {
+    canonicalPath = fileLoc;
+  }
+  const uint64_t contentHash = hashBytes(fileData.data(), fileData.size());
+
+  // Size of the decoded image, what a hit saves in upload and device memory
+  uint64_t imageSize = fileData.size();
+  if (!BakedTexture::IsBaked(fileData.data(), fileData.size()))
+  {
+    int width = 0, height = 0, channels = 0;
+    stbi_info_from_memory(fileData.data(), static_cast<int>(fileData.size()), &width, &height, &channels);
+    imageSize = static_cast<uint64_t>(width) * height * 4;
+  }
+
+  int texId = textureCache.acquire(canonicalPath, contentHash, imageSize);
+  if (texId >= 0)
+  {
+    return texId;
+  }
+
+  // Decoded and uploaded in the background once requested, the slot draws with the placeholder until then
+  texId = static_cast<int>(textureDescriptors.size());
+  textureDescriptors.push_back(0);
+  textureImages.push_back(VK_NULL_HANDLE);
+  textureImageMemory.push_back(DeviceAllocation());
+  textureImageViews.push_back(VK_NULL_HANDLE);
+  textureCache.add(canonicalPath, contentHash, texId);
+  requests.push_back({ static_cast<uint32_t>(texId), filename, std::move(fileData) });
+
+  return texId;
+}
+
+void VulkanRenderer::updateTextureStreaming()
+{
+  residentTextures.clear();
+  textureStreamer.update(residentTextures);
+
+  // New descriptors are unused by the frames in flight, the slot switches to them for the frames recorded next
+  for (const auto& texture : residentTextures)
+  {
+    // Released while it was streamed, never sampled
+    if (textureDescriptors[texture.slot] < 0)
+    {
+      retiredTextures.push_back({ texture.image, texture.memory, texture.imageView, -1, 0 });
+      continue;
+    }
+
+    textureImages[texture.slot] = texture.image;
+    textureImageMemory[texture.slot] = texture.memory;
+    textureImageViews[texture.slot] = texture.imageView;
+
+    textureDescriptors[texture.slot] = createTextureDescriptor(texture.imageView);
+  }
+}
+
+void VulkanRenderer::releaseTexture(int texId)
 {
-  VkDescriptorSet descriptorSet;
-  
-  VkDescriptorSetAllocateInfo descriptorAllocateInfo = {};
-  descriptorAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-  descriptorAllocateInfo.descriptorPool = samplerDescriptorPool;
-  descriptorAllocateInfo.descriptorSetCount = 1;
-  descriptorAllocateInfo.pSetLayouts = &samplerSetLayout;
+  if (!textureCache.release(texId))
+  {
+    return;
+  }
+
+  // Frames already submitted may still sample it, a texture not resident yet is retired when its upload completes
+  if (textureImages[texId] != VK_NULL_HANDLE)
+  {
+    retiredTextures.push_back({ textureImages[texId], textureImageMemory[texId], textureImageViews[texId],
+                                textureDescriptors[texId], MAX_FRAME_DRAWS });
+    textureImages[texId] = VK_NULL_HANDLE;
+    textureImageMemory[texId] = DeviceAllocation();
+    textureImageViews[texId] = VK_NULL_HANDLE;
+  }
+  textureDescriptors[texId] = -1;
+}
 
-  if (vkAllocateDescriptorSets(mainDevice.logicalDevice, &descriptorAllocateInfo, &descriptorSet))
+void VulkanRenderer::destroyRetiredTextures(bool all)
+{
+  // Called once per frame after waiting on its fence, every frame in flight was waited on after MAX_FRAME_DRAWS calls
+  size_t kept = 0;
+  for (auto& texture : retiredTextures)
   {
-    throw std::runtime_error("Failed to allocate texture descriptor set");
+    if (!all && texture.framesLeft > 0 && --texture.framesLeft > 0)
+    {
+      retiredTextures[kept++] = texture;
+      continue;
+    }
+
+    vkDestroyImageView(mainDevice.logicalDevice, texture.imageView, m_pAllocCB);
+    vkDestroyImage(mainDevice.logicalDevice, texture.image, m_pAllocCB);
+    deviceAllocator.free(texture.memory);
+    if (texture.descriptor >= 0)
+    {
+      freeTextureDescriptors.push_back(texture.descriptor);
+    }
   }
+  retiredTextures.resize(kept);
+}
 
+int VulkanRenderer::createTextureDescriptor(VkImageView textureImage)
+{
   VkDescriptorImageInfo imageInfo = {};
   imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;     // layout when in use
   imageInfo.imageView = textureImage;
   imageInfo.sampler = textureSampler;
 
+  // Descriptors of destroyed textures come first, no frame in flight uses them anymore
+  int descriptor = -1;
+  if (!freeTextureDescriptors.empty())
+  {
+    descriptor = freeTextureDescriptors.back();
+    freeTextureDescriptors.pop_back();
+  }
+
+  // Otherwise the texture is the next element of the array, frames in flight never index it
+  if (bindlessTexturesSupported)
+  {
+    if (descriptor < 0)
+    {
+      if (textureDescriptorCount >= textureArraySize)
+      {
+        throw std::runtime_error("Texture array is full");
+      }
+      descriptor = textureDescriptorCount++;
+    }
+
+    VkWriteDescriptorSet descriptorWrite = {};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = textureArrayDescriptorSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = descriptor;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(mainDevice.logicalDevice, 1, &descriptorWrite, 0, nullptr);
+
+    return descriptor;
+  }
+
+  if (descriptor < 0)
+  {
+    VkDescriptorSet descriptorSet;
+
+    VkDescriptorSetAllocateInfo descriptorAllocateInfo = {};
+    descriptorAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorAllocateInfo.descriptorPool = samplerDescriptorPools.back();
+    descriptorAllocateInfo.descriptorSetCount = 1;
+    descriptorAllocateInfo.pSetLayouts = &samplerSetLayout;
+
+    VkResult result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &descriptorAllocateInfo, &descriptorSet);
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+    {
+      // Sets of the full pool stay valid, the next ones come from a pool twice as large
+      createSamplerDescriptorPool(SAMPLER_POOL_SET_COUNT << samplerDescriptorPools.size());
+      descriptorAllocateInfo.descriptorPool = samplerDescriptorPools.back();
+      result = vkAllocateDescriptorSets(mainDevice.logicalDevice, &descriptorAllocateInfo, &descriptorSet);
+    }
+    if (result != VK_SUCCESS)
+    {
+      throw std::runtime_error("Failed to allocate texture descriptor set");
+    }
+
+    samplerDescriptorSets.push_back(descriptorSet);
+    descriptor = static_cast<int>(samplerDescriptorSets.size() - 1);
+  }
+
   VkWriteDescriptorSet descriptorWrite = {};
   descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  descriptorWrite.dstSet = descriptorSet;
+  descriptorWrite.dstSet = samplerDescriptorSets[descriptor];
   descriptorWrite.dstBinding = 0;
   descriptorWrite.dstArrayElement = 0;
   descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -2004,22 +3126,57 @@ int VulkanRenderer::createTextureDescriptor(VkImageView textureImage)
 
   vkUpdateDescriptorSets(mainDevice.logicalDevice, 1, &descriptorWrite, 0, nullptr);
 
-  samplerDescriptorSets.push_back(descriptorSet);
-
-  return samplerDescriptorSets.size() - 1;
+  return descriptor;
 }
 
 int VulkanRenderer::createMeshModel(const std::string& modelFile)
 {
-  // Import model "scene"
-  Assimp::Importer importer;
-  const aiScene* scene = importer.ReadFile(modelFile, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
-  if (!scene)
+  // Models of a file already loaded share its meshes, their draws get instanced together
+  auto assetIt = meshAssets.find(modelFile);
+  if (assetIt != meshAssets.end())
+  {
+    if (std::shared_ptr<MeshAsset> loadedAsset = assetIt->second.lock())
+    {
+      modelList.push_back(new MeshModel(loadedAsset, sceneGraph));
+      return modelList.size() - 1;
+    }
+  }
+
+  const uint32_t importFlags = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices;
+
+  // Use the binary cache written by a previous import if the model files didn't change since then
+  const std::string cacheFile = modelFile + ".meshcache";
+
+  MeshCache meshCache;
+  if (!meshCache.load(cacheFile, modelFile, importFlags))
   {
-    throw std::runtime_error("Failed top load model " + modelFile);
+    // Import model "scene"
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(modelFile, importFlags);
+    if (!scene)
+    {
+      throw std::runtime_error("Failed top load model " + modelFile);
+    }
+
+    // Meshes are reordered for the vertex cache once, the cache stores the optimized order
+    meshCache.setTextureNames(MeshModel::LoadMaterials(scene));
+    for (size_t i = 0; i < scene->mNumMeshes; ++i)
+    {
+      MeshModel::LoadMesh(scene->mMeshes[i], scene, meshCache);
+    }
+    MeshModel::LoadNode(scene->mRootNode, -1, meshCache);
+    meshCache.build();
+
+    // Not being able to write the cache only means the next run imports the model again
+    if (!meshCache.save(cacheFile, modelFile, importFlags))
+    {
+      printf("Warning: unable to write mesh cache %s\n", cacheFile.c_str());
+    }
   }
 
-  std::vector<std::string> textureNames = MeshModel::LoadMaterials(scene);
+  // Textures of the model are decoded in parallel and uploaded together
+  const std::vector<std::string>& textureNames = meshCache.getTextureNames();
+  std::vector<TextureStreamer::Request> textureRequests;
   std::vector<int> matToTex(textureNames.size());
   for (size_t i = 0; i < textureNames.size(); ++i)
   {
@@ -2030,13 +3187,26 @@ int VulkanRenderer::createMeshModel(const std::string& modelFile)
     }
     else
     {
-      matToTex[i] = createTexture(textureNames[i]);
+      matToTex[i] = createTexture(textureNames[i], textureRequests);
     }
   }
+  textureStreamer.request(std::move(textureRequests));
+
+  std::vector<Mesh*> modelMeshes = MeshModel::CreateMeshes(mainDevice.logicalDevice, deviceAllocator, geometryArena,
+                                                           graphicsQueue, graphicsCommandPool, meshCache, matToTex,
+                                                           vertexFormat, m_pAllocCB);
+  if (clusterCullingSupported)
+  {
+    // Arena replaces its meshlet buffer when it grows
+    clusterCuller.setMeshletBuffer(geometryArena.getMeshletBuffer());
+  }
+  std::vector<MeshNode> nodes(meshCache.getNodes(), meshCache.getNodes() + meshCache.getNodeCount());
+  std::vector<uint32_t> nodeMeshes(meshCache.getNodeMeshes(), meshCache.getNodeMeshes() + meshCache.getNodeMeshCount());
+  auto asset = std::make_shared<MeshAsset>(modelMeshes, matToTex, nodes, nodeMeshes,
+                                           [this](int texId) { releaseTexture(texId); });
+  meshAssets[modelFile] = asset;
 
-  std::vector<Mesh*> modelMeshes = MeshModel::LoadNode(mainDevice.physicalDevice, mainDevice.logicalDevice, graphicsQueue,
-                                                       graphicsCommandPool, scene->mRootNode, scene, matToTex, m_pAllocCB);
-  modelList.push_back(new MeshModel(modelMeshes));
+  modelList.push_back(new MeshModel(asset, sceneGraph));
   return modelList.size() - 1;
 }
 
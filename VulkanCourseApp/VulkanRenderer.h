@@ -7,13 +7,28 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <array>
+#include <map>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 #include <set>
 #include <algorithm>
 
+#include "DeviceAllocator.h"
+#include "CpuCuller.h"
+#include "FrameRingBuffer.h"
+#include "GpuCuller.h"
+#include "ClusterCuller.h"
+#include "SceneGraph.h"
 #include "Mesh.h"
+#include "MeshCache.h"
 #include "MeshModel.h"
+#include "MipChain.h"
+#include "RenderQueue.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
 #include "stb_image.h"
 #include "Utilities.h"
 
@@ -31,6 +46,48 @@ public:
   void draw();
   void cleanup();
 
+  // Draws go through vkCmdDrawIndexedIndirect when the device supports it, the per draw path stays as fallback
+  bool isIndirectDrawingSupported() const { return indirectDrawSupported; }
+  void setIndirectDrawing(bool enable) { indirectDrawEnabled = enable && indirectDrawSupported; }
+  bool isIndirectDrawingEnabled() const { return indirectDrawEnabled; }
+
+  // Frustum culling in a compute pass before the render pass, only used with indirect drawing
+  bool isGpuCullingSupported() const { return gpuCullingSupported; }
+  void setGpuCulling(bool enable) { gpuCullingEnabled = enable && gpuCullingSupported; }
+  bool isGpuCullingEnabled() const { return gpuCullingEnabled; }
+
+  // The GPU culling pass also culls the meshlets of the full detail meshes, against the frustum and their normal cone
+  bool isClusterCullingSupported() const { return clusterCullingSupported; }
+  void setClusterCulling(bool enable) { clusterCullingEnabled = enable && clusterCullingSupported; }
+  bool isClusterCullingEnabled() const { return clusterCullingEnabled; }
+
+  // Frustum culling on the CPU, used when the GPU culling pass doesn't run
+  void setCpuCulling(bool enable) { cpuCullingEnabled = enable; }
+  bool isCpuCullingEnabled() const { return cpuCullingEnabled; }
+
+  // 16 bytes vertices with quantized positions instead of 32 bytes, when the device can read them. Set before init().
+  void setCompactVertices(bool enable) { compactVerticesEnabled = enable; }
+  VertexFormat getVertexFormat() const { return vertexFormat; }
+
+  // Each draw uses the coarsest LOD of its mesh whose error projects to less than a pixel
+  void setLodSelection(bool enable) { lodSelectionEnabled = enable; }
+  bool isLodSelectionEnabled() const { return lodSelectionEnabled; }
+
+  struct FrameStats
+  {
+    uint32_t drawCount = 0;         // Draws in the scene, before culling
+    uint32_t drawCalls = 0;         // Draw commands recorded, an indirect draw counts once for all its draws
+    uint32_t visibleCount = 0;      // Draws left after culling, read back from the GPU a few frames late
+    float cpuCullTime = 0.0f;       // Milliseconds spent in the CPU culler
+    uint32_t bindCount = 0;         // Pipeline, buffer, descriptor set and push constant commands recorded
+    uint32_t bindsSkipped = 0;      // Those left out because the same state was already bound
+    uint64_t triangleCount = 0;     // Triangles of the recorded draws, before GPU culling
+  };
+  const FrameStats& getFrameStats() const { return frameStats; }
+
+  // Texture files shared between materials and models, counted when their models are created
+  const TextureCache::Stats& getTextureCacheStats() const { return textureCache.getStats(); }
+
 private:
   GLFWwindow* m_pWindow;
   bool m_bValidationLayers;
@@ -39,12 +96,29 @@ private:
 
   std::vector<MeshModel*> modelList;
 
+  // Transforms of the models and of the nodes of their files, updated once per frame before building the draws
+  SceneGraph sceneGraph;
+
+  // Meshes of each model file, shared by all its models. Only the models own them, a file is imported
+  // again once every model using it was destroyed.
+  std::map<std::string, std::weak_ptr<MeshAsset>> meshAssets;
+
   struct UboViewProjection
   {
     glm::mat4 projection;
     glm::mat4 view;
   } uboViewProjection;
 
+  // Per instance data read by the instanced pipeline, std430 layout
+  struct ObjectData
+  {
+    glm::mat4 model;
+    glm::vec4 positionScale;        // Dequantization of packed vertices, w unused
+    glm::vec4 positionBias;
+    uint32_t textureIndex;
+    uint32_t padding[3];
+  };
+
   // Vulkan Components
   VkInstance instance;
   VkAllocationCallbacks* m_pAllocCB;
@@ -54,7 +128,10 @@ private:
     VkPhysicalDevice physicalDevice;
     VkDevice logicalDevice;
   } mainDevice;
+  DeviceAllocator deviceAllocator;
+  GeometryArena geometryArena;
   VkQueue graphicsQueue;
+  VkQueue transferQueue;
   VkQueue presentationQueue;
   VkSurfaceKHR surface;
   VkSwapchainKHR swapchain;
@@ -63,16 +140,63 @@ private:
   std::vector<VkFramebuffer> swapChainFramebuffers;
   std::vector<VkCommandBuffer> commandBuffers;
 
+  // Draws of the first subpass are recorded in parallel, one secondary command buffer per chunk of draws.
+  // Each frame in flight has its own pools, indexed by currentFrame * thread count + chunk
+  ThreadPool threadPool;
+  std::vector<VkCommandPool> secondaryCommandPools;
+  std::vector<VkCommandBuffer> secondaryCommandBuffers;
+
+  struct DrawItem
+  {
+    uint32_t modelIndex;
+    uint32_t meshIndex;
+    uint32_t nodeIndex;             // Scene graph node of the transform
+    uint32_t lod;
+    uint64_t key;                   // Render queue key, the draw is only queued if it passes culling
+  };
+  std::vector<DrawItem> drawItems;
+  Mesh* getDrawMesh(uint32_t drawIndex) const { return modelList[drawItems[drawIndex].modelIndex]->getMesh(drawItems[drawIndex].meshIndex); }
+  // Model matrix with the dequantization of packed vertices, for the transforms without object data
+  glm::mat4 getDrawTransform(uint32_t drawIndex) const
+  {
+    const Mesh* mesh = getDrawMesh(drawIndex);
+    return glm::scale(glm::translate(sceneGraph.getWorldTransform(drawItems[drawIndex].nodeIndex), mesh->getPositionBias()),
+                      mesh->getPositionScale());
+  }
+  RenderQueue renderQueue;
+
+  // Consecutive queued draws of the same mesh and LOD, drawn with a single instanced draw.
+  // Instances are the render queue entries from firstInstance, their object data has the same index.
+  struct DrawBatch
+  {
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+    uint32_t lod;
+  };
+  std::vector<DrawBatch> drawBatches;
+  Mesh* getBatchMesh(const DrawBatch& batch) const { return getDrawMesh(renderQueue.getDrawIndex(batch.firstInstance)); }
+  const MeshLod& getBatchLod(const DrawBatch& batch) const { return getBatchMesh(batch)->getLod(batch.lod); }
+
+  FrameStats frameStats;
+  std::vector<FrameStats> chunkStats;
+
   std::vector<VkImage> colorBufferImage;
-  std::vector<VkDeviceMemory> colorBufferImageMemory;
+  std::vector<DeviceAllocation> colorBufferImageMemory;
   std::vector<VkImageView> colorBufferImageView;
 
   std::vector<VkImage> depthBufferImage;
-  std::vector<VkDeviceMemory> depthBufferImageMemory;
+  std::vector<DeviceAllocation> depthBufferImageMemory;
   VkFormat depthBufferFormat;
   std::vector<VkImageView> depthBufferImageView;
 
   bool samplerAnisotropySupported;
+  // BC formats, needed to load the textures baked by the AssetBaker
+  bool compressedTexturesSupported;
+
+  // Layout of the vertices in the geometry arena, chosen at init
+  VertexFormat vertexFormat;
+  bool compactVerticesEnabled;
+  bool compactVerticesSupported;
 
   VkSampler textureSampler;
 
@@ -82,31 +206,104 @@ private:
   VkPushConstantRange pushConstantRange;
 
   VkDescriptorPool descriptorPool;
-  VkDescriptorPool samplerDescriptorPool;
+  std::vector<VkDescriptorPool> samplerDescriptorPools;     // Sets come from the last one, a full pool is followed by a larger one
   VkDescriptorPool inputDescriptorPool;
-  std::vector<VkDescriptorSet> descriptorSets;
+  VkDescriptorSet descriptorSet;
   std::vector<VkDescriptorSet> samplerDescriptorSets;
+
+  // With descriptor indexing, every texture is an element of a single sampler array bound once,
+  // the fragment shader indexes it with the texture index of the object data
+  bool bindlessTexturesSupported;
+  uint32_t textureArraySize;
+  uint32_t textureDescriptorCount;
+  VkDescriptorSet textureArrayDescriptorSet;
+  VkDescriptorSet getTextureDescriptorSet(int texId) const { return bindlessTexturesSupported ? textureArrayDescriptorSet : samplerDescriptorSets[texId]; }
   std::vector<VkDescriptorSet> inputDescriptorSets;
 
   VkDeviceSize minUniformBufferOffset;
-  size_t modelUniformAlignment;
-  Model* modelTransferSpace;
+  VkDeviceSize minStorageBufferOffset;
 
-  std::vector<VkBuffer> vpUniformBuffer;
-  std::vector<VkDeviceMemory> vpUniformBufferMemory;
+  // Per-frame data (uniforms, object data, indirect commands), offsets of this frame's allocations are bound as dynamic offsets
+  FrameRingBuffer frameData;
+  uint32_t vpUniformOffset;
+  uint32_t objectDataOffset;
+  uint32_t instanceIndicesOffset;
 
-  std::vector<VkBuffer> modelUniformBufferDynamic;
-  std::vector<VkDeviceMemory> modelUniformBufferMemoryDynamic;
+  // Batches of the indirect path, one indirect draw per group of batches using the same texture and index buffer
+  struct IndirectGroup
+  {
+    int texId;
+    VkIndexType indexType;
+    uint32_t firstBatch;
+    uint32_t batchCount;
+    uint32_t firstCommand;            // Commands of the group, one per batch unless clusters are culled
+    uint32_t commandCount;
+    uint32_t firstNonIndexedBatch;    // Meshes without indices, drawn one by one after the group
+    uint32_t nonIndexedBatchCount;
+  };
+  std::vector<IndirectGroup> indirectGroups;
+  std::vector<uint32_t> nonIndexedBatches;
+  uint32_t indirectCommandsOffset;
+  uint32_t indirectCountsOffset;
+  uint32_t cullDrawsOffset;
+  uint32_t cullDrawCount;
 
   VkCommandPool graphicsCommandPool;
 
+  // Per texture slot, null until the texture of the slot is resident
   std::vector<VkImage> textureImages;
-  std::vector<VkDeviceMemory> textureImageMemory;
+  std::vector<DeviceAllocation> textureImageMemory;
   std::vector<VkImageView> textureImageViews;
 
+  // Meshes refer to a texture slot, each slot uses the placeholder descriptor 0 until its texture is resident.
+  // Slots aren't reused, a released slot has no descriptor (-1) and its texture is destroyed once no frame in
+  // flight can sample it, its descriptor is then free for the next texture.
+  TextureStreamer textureStreamer;
+  TextureCache textureCache;
+  std::vector<int> textureDescriptors;
+  std::vector<TextureStreamer::ResidentTexture> residentTextures;
+  int getTextureDescriptor(int texId) const { return textureDescriptors[texId]; }
+
+  struct RetiredTexture
+  {
+    VkImage image;
+    DeviceAllocation memory;
+    VkImageView imageView;
+    int descriptor;               // -1 if it never had one
+    uint32_t framesLeft;          // Frames to wait for until no submitted frame can use it
+  };
+  std::vector<RetiredTexture> retiredTextures;
+  std::vector<int> freeTextureDescriptors;
+
   VkPipeline graphicsPipeline;
   VkPipelineLayout pipelineLayout;
 
+  // Same layout as graphicsPipeline, the transform comes from the object data of the instance
+  VkPipeline instancedPipeline;
+  bool instancingSupported;
+  bool indirectDrawSupported;
+  bool indirectDrawEnabled;
+  bool indirectCountSupported;
+  PFN_vkCmdDrawIndexedIndirectCountKHR pfnCmdDrawIndexedIndirectCount;
+
+  GpuCuller gpuCuller;
+  bool gpuCullingSupported;
+  bool gpuCullingEnabled;
+  // Where each frame's culling pass wrote its visible count, read once the frame fence signaled
+  std::array<VkDeviceSize, MAX_FRAME_DRAWS> visibleCountOffsets;
+  uint32_t gpuVisibleCount;
+
+  ClusterCuller clusterCuller;
+  bool clusterCullingSupported;
+  bool clusterCullingEnabled;
+
+  CpuCuller cpuCuller;
+  bool cpuCullingEnabled;
+  std::vector<uint32_t> visibleDraws;
+  float cpuCullTime;
+
+  bool lodSelectionEnabled;
+
   VkPipeline secondPipeline;
   VkPipelineLayout secondPipelineLayout;
 
@@ -128,6 +325,7 @@ private:
   void createSwapChain();
   void createRenderPass();
   void createDescriptorSetLayout();
+  void createSamplerSetLayout();
   void createPushConstantRange();
   void createGraphicsPipeline();
   void createColorBufferImage();
@@ -140,19 +338,36 @@ private:
 
   void createUniformBuffers();
   void createDescriptorPool();
+  void createSamplerDescriptorPool(uint32_t setCount);
   void createDescriptorSets();
+  void writeDescriptorSet();
   void createInputDescriptorSets();
+  void createCullingPipeline();
+  void updateTextureStreaming();
 
-  void updateUniformBuffers(uint32_t imageIndex);
+  void buildDrawList();
+  void updateUniformBuffers();
+  void writeIndirectCommands();
+  bool isGpuCullingActive() const { return indirectDrawEnabled && gpuCullingEnabled; }
+  bool isCpuCullingActive() const { return cpuCullingEnabled && !isGpuCullingActive(); }
+  bool isClusterCullingActive() const { return isGpuCullingActive() && clusterCullingEnabled; }
+  uint32_t getClusterCommandCount(const DrawBatch& batch) const;
 
   void recordCommands(uint32_t currentImage);
+  void recordSecondaryCommands(VkCommandBuffer commandBuffer,
+                               const VkCommandBufferInheritanceInfo& inheritanceInfo,
+                               size_t firstBatch,
+                               size_t batchCount,
+                               FrameStats& stats);
+  void recordIndirectCommands(VkCommandBuffer commandBuffer,
+                              const VkCommandBufferInheritanceInfo& inheritanceInfo,
+                              FrameStats& stats);
 
   void getPhysicalDevice();
 
-  void allocateDynamicBufferTransferSpace();
-
   bool checkInstanceExtensionSupport(const std::vector<const char*>& a_rExtensions);
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool hasDeviceExtension(VkPhysicalDevice device, const char* extensionName);
   bool checkValidationLayerSupport();
   std::vector<const char*> getRequiredExtensions();
   bool checkSuitableDevice(VkPhysicalDevice device);
@@ -165,14 +380,18 @@ private:
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& surfaceCapabilities);
   VkFormat chooseSupportedFormat(const std::vector<VkFormat>& formats, VkImageTiling tiling, VkFormatFeatureFlags featureFlags);
 
-  std::tuple<VkImage, VkDeviceMemory> createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
-                                                  VkImageUsageFlags useFlags, VkMemoryPropertyFlags propFlags);
-  VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
+  std::tuple<VkImage, DeviceAllocation> createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
+                                                    VkImageUsageFlags useFlags, VkMemoryPropertyFlags propFlags,
+                                                    uint32_t mipLevels = 1);
+  VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels = 1);
   VkShaderModule createShaderModule(const std::vector<char>& code);
 
-  int createTextureImage(const std::string& filename);
-  int createTexture(const std::string& filename);
+  int createTextureImage(const std::string& filename, uint32_t& mipLevels);
+  int loadTexture(const std::string& filename);
+  int createTexture(const std::string& filename, std::vector<TextureStreamer::Request>& requests);
   int createTextureDescriptor(VkImageView textureImage);
+  void releaseTexture(int texId);
+  void destroyRetiredTextures(bool all);
 
   stbi_uc* loadTextureFile(const std::string& filename, int& width, int& height, VkDeviceSize& imageSize);
 };
@@ -5,7 +5,9 @@
 
 #include <stdexcept>
 #include <vector>
+#include <cstdio>
 #include <iostream>
+#include <string>
 
 #include "VulkanRenderer.h"
 
@@ -30,9 +32,25 @@ int main()
     {
       double angle = 0.0;
       double lastTime = 0.0;
+      double lastStatsTime = 0.0;
+      bool indirectKeyDown = false;
+      bool cullingKeyDown = false;
+      bool lodKeyDown = false;
+      bool clusterKeyDown = false;
 
       int helicopterModel = vulkanRenderer.createMeshModel("Models/Seahawk.obj");
 
+      // Escort loaded from the same file shares its meshes, each mesh of the fleet is a single instanced draw
+      std::vector<int> escortModels;
+      for (int i = 0; i < 8; ++i)
+      {
+        escortModels.push_back(vulkanRenderer.createMeshModel("Models/Seahawk.obj"));
+      }
+
+      const auto& textureStats = vulkanRenderer.getTextureCacheStats();
+      printf("Texture cache: %u hits, %u misses, %llu bytes saved\n", textureStats.hits, textureStats.misses,
+             static_cast<unsigned long long>(textureStats.bytesSaved));
+
       // Loop until closed
       while (!glfwWindowShouldClose(pWindow))
       {
@@ -48,7 +66,77 @@ int main()
         matRotation = glm::rotate(matRotation, glm::radians(static_cast<float>(angle*5)), glm::vec3(0.0f, 1.0f, 0.0f));
         vulkanRenderer.updateModel(helicopterModel, matRotation);
 
+        for (size_t i = 0; i < escortModels.size(); ++i)
+        {
+          float escortAngle = static_cast<float>(angle) + 360.0f * i / escortModels.size();
+          glm::mat4 matEscort = glm::rotate(matRotation, glm::radians(escortAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+          matEscort = glm::translate(matEscort, glm::vec3(0.0f, 1.0f, -4.0f));
+          matEscort = glm::scale(matEscort, glm::vec3(0.5f));
+          vulkanRenderer.updateModel(escortModels[i], matEscort);
+        }
+
+        // I switches between indirect and per draw recording
+        bool indirectKeyPressed = glfwGetKey(pWindow, GLFW_KEY_I) == GLFW_PRESS;
+        if (indirectKeyPressed && !indirectKeyDown)
+        {
+          vulkanRenderer.setIndirectDrawing(!vulkanRenderer.isIndirectDrawingEnabled());
+        }
+        indirectKeyDown = indirectKeyPressed;
+
+        // C switches culling on and off, on the GPU with indirect drawing and on the CPU otherwise
+        bool cullingKeyPressed = glfwGetKey(pWindow, GLFW_KEY_C) == GLFW_PRESS;
+        if (cullingKeyPressed && !cullingKeyDown)
+        {
+          bool culling = !vulkanRenderer.isCpuCullingEnabled();
+          vulkanRenderer.setGpuCulling(culling);
+          vulkanRenderer.setCpuCulling(culling);
+        }
+        cullingKeyDown = cullingKeyPressed;
+
+        // L switches between the LOD picked by distance and full detail
+        bool lodKeyPressed = glfwGetKey(pWindow, GLFW_KEY_L) == GLFW_PRESS;
+        if (lodKeyPressed && !lodKeyDown)
+        {
+          vulkanRenderer.setLodSelection(!vulkanRenderer.isLodSelectionEnabled());
+        }
+        lodKeyDown = lodKeyPressed;
+
+        // M switches the culling of the meshlets in the GPU culling pass
+        bool clusterKeyPressed = glfwGetKey(pWindow, GLFW_KEY_M) == GLFW_PRESS;
+        if (clusterKeyPressed && !clusterKeyDown)
+        {
+          vulkanRenderer.setClusterCulling(!vulkanRenderer.isClusterCullingEnabled());
+        }
+        clusterKeyDown = clusterKeyPressed;
+
         vulkanRenderer.draw();
+
+        // Show the draw stats in the title once per second
+        if (now - lastStatsTime >= 1.0)
+        {
+          const auto& stats = vulkanRenderer.getFrameStats();
+          std::string culling = "";
+          if (vulkanRenderer.isIndirectDrawingEnabled() && vulkanRenderer.isGpuCullingEnabled())
+          {
+            culling = vulkanRenderer.isClusterCullingEnabled() ? ", GPU culling, clusters" : ", GPU culling";
+          }
+          else if (vulkanRenderer.isCpuCullingEnabled())
+          {
+            culling = ", CPU culling " + std::to_string(stats.cpuCullTime) + " ms";
+          }
+
+          std::string title = std::string("Test Window - ") +
+                              (vulkanRenderer.isIndirectDrawingEnabled() ? "indirect" : "direct") + culling +
+                              (vulkanRenderer.isLodSelectionEnabled() ? ", LOD" : ", full detail") +
+                              ", draws: " + std::to_string(stats.drawCount) +
+                              ", visible: " + std::to_string(stats.visibleCount) +
+                              ", draw calls: " + std::to_string(stats.drawCalls) +
+                              ", binds: " + std::to_string(stats.bindCount) +
+                              ", binds skipped: " + std::to_string(stats.bindsSkipped) +
+                              ", triangles: " + std::to_string(stats.triangleCount);
+          glfwSetWindowTitle(pWindow, title.c_str());
+          lastStatsTime = now;
+        }
       }
     }
 